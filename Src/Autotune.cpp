@@ -0,0 +1,202 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Config.hpp"
+#include "Global.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+template <typename T, unsigned D>
+class Hamiltonian;
+template <typename T, unsigned D>
+class KPM_Vector;
+#include "queue.hpp"
+#include "Simulation.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+#include "Autotune.hpp"
+#include "MemoryPlan.hpp"
+#include <array>
+
+namespace {
+template <unsigned D>
+void decompositions(std::vector<std::array<unsigned, D>> & all, std::array<unsigned, D> & nd,
+                    unsigned i, unsigned threads, const unsigned * L){
+  // All the divisions with threads domains in total that leave a multiple of TILE in each one
+  if(i == D - 1){
+    nd[i] = threads;
+    if(L[i]%(threads*TILE) == 0)
+      all.push_back(nd);
+    return;
+  }
+  for(unsigned n = 1; n <= threads; n++)
+    if(threads%n == 0 && L[i]%(n*TILE) == 0){
+      nd[i] = n;
+      decompositions<D>(all, nd, i + 1, threads/n, L);
+    }
+}
+}
+
+template <typename T, unsigned D>
+void Autotune<T,D>::run(char *name){
+  H5::H5File * file = Config::open(name);
+  unsigned L[D], divisions[D];
+  int teams = 1, ensemble = 1;
+  get_hdf5<unsigned>(L, file, (char *) "/L");
+  get_hdf5<unsigned>(divisions, file, (char *) "/Divisions");
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&teams, file, (char *) "/Teams");
+  } catch(H5::Exception& e) {}
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&ensemble, file, (char *) "/Ensemble");
+  } catch(H5::Exception& e) {}
+
+  unsigned threads = 1;
+  for(unsigned i = 0; i < D; i++)
+    threads *= divisions[i];
+  char *env = getenv("OMP_NUM_THREADS");
+  if(env != NULL && atoi(env) > 0)
+    threads = atoi(env);
+  int steps = 10;
+  env = getenv("AUTOTUNE_STEPS");
+  if(env != NULL && atoi(env) > 0)
+    steps = atoi(env);
+
+  std::vector<std::array<unsigned, D>> candidates;
+  std::array<unsigned, D> nd;
+  decompositions<D>(candidates, nd, 0, threads, L);
+  if(candidates.empty()){
+    std::cout << "Autotune: no division of the lattice into " << threads << " domains is a multiple "
+              << "of TILE (" << TILE << ") in every direction. Keeping /Divisions.\n";
+    return;
+  }
+
+  // Each candidate runs on a copy of the configuration in memory, with its own /Divisions
+  hssize_t size = H5Fget_file_image(file->getId(), NULL, 0);
+  std::vector<char> image(size);
+  H5Fget_file_image(file->getId(), image.data(), size);
+  const double available = MemoryPlan::available();
+
+  std::cout << "Autotuning the division of the lattice into " << threads << " domains:\n";
+  const long n = candidates.size();
+  Eigen::Array<unsigned, -1, -1> tried(D, n);
+  Eigen::Array<double, -1, -1> seconds(1, n), megabytes(1, n);
+  long best = -1;
+  for(long c = 0; c < n; c++){
+    std::string copy = std::string(name) + " (autotune)";
+    H5::FileAccPropList access;
+    access.setCore(1 << 20, false);
+    H5Pset_file_image(access.getId(), image.data(), image.size());
+    H5::H5File * tuned = new H5::H5File(copy, H5F_ACC_RDWR, H5::FileCreatPropList::DEFAULT, access);
+    tuned->openDataSet("/Divisions").write(candidates.at(c).data(), H5::PredType::NATIVE_UINT);
+    Config::add(copy, tuned);
+
+    // Peak memory of the run with this decomposition, for all the teams
+    LatticeStructure<D> r(&copy[0]);
+    for(unsigned i = 0; i < D; i++)
+      tried(i, c) = r.nd[i];
+    megabytes(c) = MemoryPlan::estimate<T,D>(&copy[0], r, std::max(teams, ensemble), false)/1024.0/1024.0;
+    seconds(c) = -1;
+
+    std::cout << "  Divisions";
+    for(unsigned i = 0; i < D; i++)
+      std::cout << (i == 0 ? " " : " x ") << r.nd[i];
+    if(megabytes(c)*1024.0*1024.0 > available){
+      std::cout << ": needs " << megabytes(c) << " MB, more than the memory available. Skipped.\n";
+      Config::release(copy);
+      continue;
+    }
+
+    GLOBAL_VARIABLES<T> Global;
+    Global.ghosts.resize(r.get_BorderSize());
+    std::fill(Global.ghosts.begin(), Global.ghosts.end(), 0);
+    omp_set_num_threads(r.n_threads);
+    std::chrono::steady_clock::time_point start;
+#pragma omp parallel default(shared)
+    {
+      Simulation<T,D> simul(&copy[0], Global);
+      simul.h.generate_disorder();
+      KPM_Vector<T,D> kpm0(2, simul);
+      kpm0.initiate_vector();
+      kpm0.Exchange_Boundaries();
+      kpm0.template Multiply<0>();
+      kpm0.template Multiply<1>();    // warm up
+#pragma omp barrier
+#pragma omp master
+      start = std::chrono::steady_clock::now();
+      for(int i = 0; i < steps; i++)
+        kpm0.template Multiply<1>();
+#pragma omp barrier
+#pragma omp master
+      seconds(c) = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()/steps;
+    }
+    Config::release(copy);
+
+    std::cout << ": " << seconds(c) << " s per multiplication, " << megabytes(c) << " MB\n";
+    if(best < 0 || seconds(c) < seconds(best))
+      best = c;
+  }
+
+  if(best < 0){
+    std::cout << "Autotune: no decomposition fits in the memory available. Keeping /Divisions.\n";
+    return;
+  }
+  std::cout << "Autotune: using the divisions";
+  for(unsigned i = 0; i < D; i++)
+    std::cout << (i == 0 ? " " : " x ") << tried(i, best);
+  std::cout << ".\n";
+
+  // The configuration is read again, with the new /Divisions
+  Config::release(name);
+  file = new H5::H5File(name, H5F_ACC_RDWR);
+  file->openDataSet("/Divisions").write(tried.col(best).data(), H5::PredType::NATIVE_UINT);
+  if(H5Lexists(file->getId(), "/Autotune", H5P_DEFAULT) > 0)
+    file->unlink("/Autotune");
+  file->createGroup("/Autotune");
+  Eigen::Array<unsigned, -1, -1> chosen = tried.col(best), parameters(1, 1);
+  write_hdf5(tried, file, "/Autotune/Candidates");
+  write_hdf5(seconds, file, "/Autotune/Seconds");
+  write_hdf5(megabytes, file, "/Autotune/MB");
+  write_hdf5(chosen, file, "/Autotune/Divisions");
+  parameters(0) = threads;
+  write_hdf5(parameters, file, "/Autotune/Threads");
+  parameters(0) = TILE;
+  write_hdf5(parameters, file, "/Autotune/TILE");
+  parameters(0) = MEMORY;
+  write_hdf5(parameters, file, "/Autotune/MEMORY");
+  file->close();
+  delete file;
+}
+
+template class Autotune<float ,1u>;
+template class Autotune<double ,1u>;
+template class Autotune<long double ,1u>;
+template class Autotune<std::complex<float> ,1u>;
+template class Autotune<std::complex<double> ,1u>;
+template class Autotune<std::complex<long double> ,1u>;
+
+template class Autotune<float ,2u>;
+template class Autotune<double ,2u>;
+template class Autotune<long double ,2u>;
+template class Autotune<std::complex<float> ,2u>;
+template class Autotune<std::complex<double> ,2u>;
+template class Autotune<std::complex<long double> ,2u>;
+
+template class Autotune<float ,3u>;
+template class Autotune<double ,3u>;
+template class Autotune<long double ,3u>;
+template class Autotune<std::complex<float> ,3u>;
+template class Autotune<std::complex<double> ,3u>;
+template class Autotune<std::complex<long double> ,3u>;
@@ -0,0 +1,21 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+// Startup autotuner of the domain decomposition, run with KITEx --autotune config.h5. It times
+// a few Multiply<1> steps with each decomposition of the threads into /Divisions that divides
+// the lattice in multiples of TILE, and keeps the fastest one that fits in the memory given by
+// MemoryPlan. The threads are those of /Divisions, or OMP_NUM_THREADS when it is set, and
+// AUTOTUNE_STEPS (10 by default) sets the steps timed for each decomposition. The choice is
+// written to /Divisions, so the run and later runs use it, and the times of all the candidates
+// to /Autotune. TILE and MEMORY are compilation parameters and are only recorded there
+template <typename T, unsigned D>
+class Autotune {
+public:
+  static void run(char *);
+};
@@ -0,0 +1,172 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "CheckpointWriter.hpp"
+#include <cstdio>
+
+static void write_string(H5::H5File * file, std::string name, const std::string & value){
+  H5::StrType datatype(H5::PredType::C_S1, std::max<std::size_t>(1, value.size()));
+  H5::DataSet dataset = file->createDataSet(name, datatype, H5::DataSpace(H5S_SCALAR));
+  dataset.write(value, datatype);
+}
+
+static std::string read_string(H5::H5File * file, std::string name){
+  H5::DataSet dataset = file->openDataSet(name);
+  std::string value;
+  dataset.read(value, dataset.getStrType());
+  return value;
+}
+
+
+template <typename T>
+CheckpointWriter<T>::CheckpointWriter(std::string file_name):
+  filename(file_name), has_pending(false), finished(false){
+  worker = std::thread(&CheckpointWriter<T>::run, this);
+}
+
+
+template <typename T>
+CheckpointWriter<T>::~CheckpointWriter(){
+  // Waits for the pending checkpoint to be written
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  ready.notify_one();
+  worker.join();
+}
+
+
+template <typename T>
+void CheckpointWriter<T>::push(CheckpointState<T> && state){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = std::move(state);
+    has_pending = true;
+  }
+  ready.notify_one();
+}
+
+
+template <typename T>
+void CheckpointWriter<T>::run(){
+  while(true){
+    CheckpointState<T> state;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this]{return finished || has_pending;});
+      if(!has_pending)
+        break;
+      state = std::move(pending);
+      has_pending = false;
+    }
+    try{
+      write(state);
+    } catch(H5::Exception& e) {
+      std::cout << "Could not write the checkpoint " << filename << ": " << e.getFuncName() << " " << e.getDetailMsg() << ".\n" << std::flush;
+    }
+  }
+}
+
+
+template <typename T>
+void CheckpointWriter<T>::write(const CheckpointState<T> & state){
+  std::string temporary = filename + ".tmp";
+  H5::H5File handle(temporary, H5F_ACC_TRUNC);
+  H5::H5File * file = &handle;
+  std::string done;
+  for(auto & name : state.done)
+    done += name + "\n";
+  write_string(file, "/Done", done);
+
+  if(state.name_dataset != ""){
+    Eigen::Array<int, -1, -1> value = Eigen::Array<int, -1, -1>::Constant(1, 1, state.disorder);
+    file->createGroup("/Current");
+    write_string(file, "/Current/Dataset", state.name_dataset);
+    write_hdf5(value, file, "/Current/Disorder");
+    value(0) = state.random;
+    write_hdf5(value, file, "/Current/RandomVector");
+    value(0) = state.average;
+    write_hdf5(value, file, "/Current/Average");
+    value(0) = state.states.size();
+    write_hdf5(value, file, "/Current/Threads");
+    // The threads without arrays of their own have no dataset
+    for(unsigned t = 0; t < state.states.size(); t++){
+      if(state.arrays.at(t).size() > 0)
+        write_hdf5(state.arrays.at(t), file, "/Current/Arrays" + std::to_string(t));
+      write_string(file, "/Current/State" + std::to_string(t), state.states.at(t));
+    }
+  }
+  handle.close();
+  if(std::rename(temporary.c_str(), filename.c_str()) != 0)
+    std::cout << "Could not write the checkpoint " << filename << ".\n" << std::flush;
+}
+
+
+template <typename T>
+bool read_checkpoint_file(std::string filename, CheckpointState<T> & state, int thread){
+  // Reads the finished datasets and, if there is a checkpoint of a Gamma matrix with the same
+  // number of threads, the position in its loops and the part of the given thread
+  state = CheckpointState<T>();
+  H5::Exception::dontPrint();
+  H5::H5File * file;
+  try{
+    file = new H5::H5File(filename, H5F_ACC_RDONLY);
+  } catch(H5::Exception& e) {
+    return false;
+  }
+
+  std::istringstream done(read_string(file, "/Done"));
+  for(std::string name; std::getline(done, name);)
+    if(name != "")
+      state.done.push_back(name);
+
+  try{
+    int threads = 0;
+    get_hdf5<int>(&threads, file, (char *) "/Current/Threads");
+    state.threads = threads;
+    if(thread < threads){
+      std::string id = std::to_string(thread);
+      int average = 0;
+      hsize_t dim[2] = {0, 0};
+      if(H5Lexists(file->getId(), ("/Current/Arrays" + id).c_str(), H5P_DEFAULT) > 0)
+        file->openDataSet("/Current/Arrays" + id).getSpace().getSimpleExtentDims(dim, NULL);
+      state.arrays.push_back(Eigen::Array<T,-1,-1>(dim[1], dim[0]));
+      if(dim[0]*dim[1] > 0)
+        get_hdf5<T>(state.arrays.at(0).data(), file, (char *) ("/Current/Arrays" + id).c_str());
+      state.states.push_back(read_string(file, "/Current/State" + id));
+      get_hdf5<int>(&state.disorder, file, (char *) "/Current/Disorder");
+      get_hdf5<int>(&state.random, file, (char *) "/Current/RandomVector");
+      get_hdf5<int>(&average, file, (char *) "/Current/Average");
+      state.average = average;
+      state.name_dataset = read_string(file, "/Current/Dataset");
+    }
+  } catch(H5::Exception& e) {}
+  file->close();
+  delete file;
+  return true;
+}
+
+
+template class CheckpointWriter<float>;
+template class CheckpointWriter<double>;
+template class CheckpointWriter<long double>;
+template class CheckpointWriter<std::complex<float>>;
+template class CheckpointWriter<std::complex<double>>;
+template class CheckpointWriter<std::complex<long double>>;
+
+template bool read_checkpoint_file(std::string, CheckpointState<float> &, int);
+template bool read_checkpoint_file(std::string, CheckpointState<double> &, int);
+template bool read_checkpoint_file(std::string, CheckpointState<long double> &, int);
+template bool read_checkpoint_file(std::string, CheckpointState<std::complex<float>> &, int);
+template bool read_checkpoint_file(std::string, CheckpointState<std::complex<double>> &, int);
+template bool read_checkpoint_file(std::string, CheckpointState<std::complex<long double>> &, int);
@@ -0,0 +1,45 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+// Everything needed to continue a Gamma matrix: its name, the position in the loops and, for
+// each thread, its partial averages packed in one column and its random number generators
+template <typename T>
+struct CheckpointState {
+  std::vector<std::string>            done;      // datasets that are already finished
+  std::string                         name_dataset;
+  int                                 disorder = 0;
+  int                                 random = 0;
+  long                                average = 0;
+  int                                 threads = 0;
+  std::vector<Eigen::Array<T,-1,-1>>  arrays;
+  std::vector<std::string>            states;
+};
+
+// Writes the checkpoints from a separate thread, so the Chebyshev iterations never wait for
+// the file. Only the newest checkpoint is kept when the writer falls behind. Each one is written
+// to a temporary file that replaces the old checkpoint, so a crash while writing keeps the old one
+template <typename T>
+class CheckpointWriter {
+  std::string                 filename;
+  CheckpointState<T>          pending;
+  bool                        has_pending;
+  std::mutex                  mutex;
+  std::condition_variable     ready;
+  bool                        finished;
+  std::thread                 worker;
+  void run();
+  void write(const CheckpointState<T> &);
+public:
+  CheckpointWriter(std::string);
+  ~CheckpointWriter();
+  void push(CheckpointState<T> &&);
+};
+
+template <typename T>
+bool read_checkpoint_file(std::string, CheckpointState<T> &, int);
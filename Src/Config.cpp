@@ -0,0 +1,86 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Config.hpp"
+#include <fstream>
+#include <iterator>
+#include <map>
+
+namespace {
+std::map<std::string, H5::H5File*> configs;
+}
+
+H5::H5File * Config::open(const std::string & name){
+  H5::H5File * file = NULL;
+#pragma omp critical (config)
+  {
+    auto found = configs.find(name);
+    if(found != configs.end())
+      file = found->second;
+  }
+  if(file != NULL)
+    return file;
+
+  char * env = getenv("CONFIG_IN_MEMORY");
+  if(env != NULL && atoi(env) == 0)
+    // The outputs are written through other handles of the file. HDF5 only lets them share
+    // this one if it was opened for writing too
+    file = new H5::H5File(name, H5F_ACC_RDWR);
+  else {
+    std::ifstream stream(name, std::ios::binary);
+    std::vector<char> image((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    if(!stream.good() && !stream.eof())
+      throw H5::FileIException("Config::open", "cannot read " + name);
+    if(image.empty())
+      throw H5::FileIException("Config::open", "cannot read " + name);
+
+    // HDF5 keeps its own copy of the image, without a backing file. The core driver does not
+    // accept the name of an existing file for an image
+    H5::FileAccPropList access;
+    access.setCore(1 << 20, false);
+    H5Pset_file_image(access.getId(), image.data(), image.size());
+    file = new H5::H5File(name + " (in memory)", H5F_ACC_RDONLY, H5::FileCreatPropList::DEFAULT, access);
+  }
+
+  // Another thread may have loaded it in the meantime
+#pragma omp critical (config)
+  {
+    auto found = configs.find(name);
+    if(found == configs.end())
+      configs[name] = file;
+    else {
+      delete file;
+      file = found->second;
+    }
+  }
+  return file;
+}
+
+void Config::add(const std::string & name, H5::H5File * file){
+  // The configuration of that name is this file, which is released like the others
+  release(name);
+#pragma omp critical (config)
+  configs[name] = file;
+}
+
+void Config::release(const std::string & name){
+  // Frees the configuration. Called when no thread uses it anymore
+#pragma omp critical (config)
+  {
+    auto found = configs.find(name);
+    if(found != configs.end()){
+      found->second->close();
+      delete found->second;
+      configs.erase(found);
+    }
+  }
+}
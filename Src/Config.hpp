@@ -0,0 +1,20 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+// Read-only configuration shared by all the threads. The first call of open reads the whole
+// file at once and keeps it in memory, through the core driver of HDF5, so the threads read
+// their parameters from memory instead of each opening the file. Set CONFIG_IN_MEMORY=0 to
+// open the file normally instead, for example when it holds large outputs of earlier runs.
+// The outputs are still written to the file, and are not seen by the configuration
+class Config {
+public:
+  static H5::H5File * open(const std::string &);   // never closed or deleted by the caller
+  static void         add(const std::string &, H5::H5File *); // one already open, such as one built in memory
+  static void         release(const std::string &);
+};
@@ -0,0 +1,125 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Diagnostics.hpp"
+#include <fstream>
+#include <iomanip>
+
+const char * Diagnostics::names[PHASES] = {"Multiply", "Exchange", "Barrier", "Contract", "Disorder", "Velocity", "IO", "Store"};
+
+Diagnostics & Diagnostics::local(){
+  thread_local Diagnostics diagnostics;
+  return diagnostics;
+}
+
+void Diagnostics::record(Phase phase, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end){
+  if(events.empty()){
+    std::size_t capacity = 1 << 16;
+    char * env = getenv("TRACE_EVENTS");
+    if(env != NULL && atol(env) > 0)
+      capacity = atol(env);
+    events.resize(capacity);
+  }
+  Event & event = events.at(recorded % events.size());
+  event.phase = phase;
+  event.begin = std::chrono::duration<double>(begin - origin()).count();
+  event.end   = std::chrono::duration<double>(end - origin()).count();
+  recorded++;
+}
+
+void Diagnostics::store(const std::string & name, const std::vector<Diagnostics> & threads){
+  // Writes /Diagnostics/<phase>/Seconds and Calls, with one entry for each thread, and the
+  // Minimum, Average and Maximum of the seconds over the threads. Replaces those of an earlier run
+  if(threads.empty())
+    return;
+  const long n = threads.size();
+  H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+  if(H5Lexists(file->getId(), "/Diagnostics", H5P_DEFAULT) > 0)
+    file->unlink("/Diagnostics");
+  file->createGroup("/Diagnostics");
+
+  for(int p = 0; p < PHASES; p++){
+    std::string group = std::string("/Diagnostics/") + names[p];
+    file->createGroup(group);
+
+    Eigen::Array<double, -1, -1> seconds(1, n);
+    Eigen::Array<int, -1, -1> calls(1, n);
+    for(long t = 0; t < n; t++){
+      seconds(t) = std::max(0.0, threads.at(t).seconds[p]);
+      calls(t) = threads.at(t).calls[p];
+    }
+    Eigen::Array<double, -1, -1> value(1, 1);
+    write_hdf5(seconds, file, group + "/Seconds");
+    write_hdf5(calls, file, group + "/Calls");
+    value(0) = seconds.minCoeff();
+    write_hdf5(value, file, group + "/Minimum");
+    value(0) = seconds.mean();
+    write_hdf5(value, file, group + "/Average");
+    value(0) = seconds.maxCoeff();
+    write_hdf5(value, file, group + "/Maximum");
+  }
+  file->close();
+  delete file;
+
+  std::cout << "Time in each phase (minimum / average / maximum over " << n << " threads, in seconds):\n";
+  for(int p = 0; p < PHASES; p++){
+    double low = 1e300, sum = 0, high = 0;
+    for(auto & thread : threads){
+      double s = std::max(0.0, thread.seconds[p]);
+      low = std::min(low, s);
+      high = std::max(high, s);
+      sum += s;
+    }
+    std::cout << "  " << names[p] << ": " << low << " / " << sum/n << " / " << high << "\n";
+  }
+}
+
+void Diagnostics::trace(const std::vector<Diagnostics> & threads, int team_threads){
+  // Writes the events of all the threads in the Trace Event Format of Chrome, which Perfetto
+  // and chrome://tracing open. Each team is a process and each of its threads a thread
+  std::ofstream out(tracing());
+  if(!out){
+    std::cout << "Could not write the trace to " << tracing() << ".\n";
+    return;
+  }
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  bool first = true;
+  std::size_t lost = 0;
+  for(std::size_t t = 0; t < threads.size(); t++){
+    const Diagnostics & thread = threads.at(t);
+    const int team = t / team_threads, id = t % team_threads;
+    out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << team
+        << ", \"tid\": " << id << ", \"args\": {\"name\": \"thread " << id << "\"}}";
+    first = false;
+    if(id == 0)
+      out << ",\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << team
+          << ", \"args\": {\"name\": \"team " << team << "\"}}";
+
+    // The oldest events of a full ring have been overwritten
+    std::size_t size = std::min(thread.recorded, thread.events.size());
+    lost += thread.recorded - size;
+    for(std::size_t e = thread.recorded - size; e < thread.recorded; e++){
+      const Event & event = thread.events.at(e % thread.events.size());
+      out << ",\n{\"name\": \"" << names[event.phase] << "\", \"ph\": \"X\", \"pid\": " << team
+          << ", \"tid\": " << id << ", \"ts\": " << event.begin*1e6
+          << ", \"dur\": " << (event.end - event.begin)*1e6 << "}";
+    }
+  }
+  out << "\n]}\n";
+  out.close();
+
+  std::cout << "Trace of " << threads.size() << " threads written to " << tracing();
+  if(lost > 0)
+    std::cout << " (without the first " << lost << " events, raise TRACE_EVENTS to keep them)";
+  std::cout << ".\n";
+}
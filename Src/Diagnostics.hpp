@@ -0,0 +1,78 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+// Time spent by each thread in the phases of the calculation, measured when the environment
+// variable DIAGNOSTICS is 1 and stored in /Diagnostics at the end of the run. Each thread
+// accumulates its own times. The timers can be nested, and the time of the inner one is not
+// counted in the outer one, so the Multiply phase is the products without their exchange of
+// the ghosts, and Exchange does not include the barriers that wait for the other threads.
+// With TRACE=<file>, each thread also keeps the begin and end of its last TRACE_EVENTS timers
+// (65536 by default) in a ring, and they are written to that file as a Chrome trace
+class Diagnostics {
+public:
+  enum Phase {MULTIPLY, EXCHANGE, BARRIER, CONTRACT, DISORDER, VELOCITY, IO, STORE, PHASES};
+  static const char * names[PHASES];
+  double seconds[PHASES] = {};
+  long   calls[PHASES] = {};
+  int    current = -1;                           // phase of the innermost timer
+
+  struct Event {
+    int    phase;
+    double begin, end;                           // seconds since the start of the run
+  };
+  std::vector<Event> events;                     // ring with the last events
+  std::size_t        recorded = 0;               // events recorded, including the overwritten
+
+  static bool enabled(){
+    static const bool on = getenv("DIAGNOSTICS") != NULL && atoi(getenv("DIAGNOSTICS")) != 0;
+    return on;
+  }
+  static const char * tracing(){                 // file of the trace, or NULL
+    static const char * file = getenv("TRACE");
+    return file;
+  }
+  static std::chrono::steady_clock::time_point origin(){
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return start;
+  }
+  static Diagnostics & local();                  // of this thread
+  static void store(const std::string &, const std::vector<Diagnostics> &);
+  static void trace(const std::vector<Diagnostics> &, int);
+  void record(Phase, std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point);
+};
+
+// Adds the time of its scope to a phase of the Diagnostics of the thread
+class ScopedTimer {
+  Diagnostics                         * diagnostics = nullptr;
+  Diagnostics::Phase                    phase;
+  int                                   parent;
+  std::chrono::steady_clock::time_point start;
+public:
+  ScopedTimer(Diagnostics::Phase p) : phase(p) {
+    if(!Diagnostics::enabled() && Diagnostics::tracing() == NULL)
+      return;
+    diagnostics = &Diagnostics::local();
+    parent = diagnostics->current;
+    diagnostics->current = phase;
+    start = std::chrono::steady_clock::now();
+  }
+  ~ScopedTimer(){
+    if(diagnostics == nullptr)
+      return;
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    diagnostics->seconds[phase] += elapsed;
+    diagnostics->calls[phase]++;
+    if(parent >= 0)
+      diagnostics->seconds[parent] -= elapsed;
+    diagnostics->current = parent;
+    if(Diagnostics::tracing() != NULL)
+      diagnostics->record(phase, start, end);
+  }
+};
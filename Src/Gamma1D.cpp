@@ -10,6 +10,7 @@
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
 #include "Global.hpp"
+#include "Diagnostics.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
@@ -24,12 +25,27 @@ class KPM_Vector;
 template <typename T,unsigned D>
 
 void Simulation<T,D>::Gamma1D(int NRandomV, int NDisorder, int N_moments,
-    std::vector<std::vector<unsigned>> indices, std::string name_dataset){
+    std::vector<std::vector<unsigned>> indices, std::string name_dataset, bool doubling, bool orbitals){
 
   int num_velocities = 0;
   for(int i = 0; i < int(indices.size()); i++)
     num_velocities += indices.at(i).size();
   int factor = 1 - (num_velocities % 2)*2;
+
+  // The doubling identities need the same vector on both sides
+  if(doubling && num_velocities != 0){
+    verbose_message("Gamma1D: the doubling identities need a Gamma matrix without velocities. Ignoring.\n");
+    doubling = false;
+  }
+  if(doubling && orbitals){
+    verbose_message("Gamma1D: the doubling identities do not split the moments by orbital. Ignoring.\n");
+    doubling = false;
+  }
+  // Only the recursions of the DOS are kept for a later run
+  if(resume.save && (doubling || num_velocities != 0)){
+    verbose_message("Gamma1D: only the recursions of the DOS without doubling can be extended. Ignoring.\n");
+    resume.save = false;
+  }
     
   // Initialize the KPM vectors that will be needed to run the 1D Gamma matrix
   KPM_Vector<T,D> kpm0(1, *this);
@@ -37,54 +53,112 @@ void Simulation<T,D>::Gamma1D(int NRandomV, int NDisorder, int N_moments,
 		
   // Make sure the local gamma matrix is zeroed
   Eigen::Array<T, -1, -1> gamma = Eigen::Array<T, -1, -1 >::Zero(1, N_moments);
-  Eigen::Matrix<T, 1, 2> tmp =  Eigen::Matrix < T, 1, 2> ::Zero();		
+  Eigen::Matrix<T, -1, -1> tmp;
+  Eigen::Matrix<T, -1, -1> kpm0_interior(r.Size, 1); // kpm0 without the ghosts
+
+  // With a stopping rule, the moments of each random vector are kept as one sample
+  const bool sampling = sampling_active();
+  Eigen::Array<T, -1, -1> sample;
+  if(sampling){
+    sample = Eigen::Array<T, -1, -1>::Zero(N_moments, 1);
+    start_sampling(N_moments, 1, {name_dataset});
+  }
+  bool stop = false;
 
   long average = 0;
-  for(int disorder = 0; disorder < NDisorder; disorder++){
+
+  // With orbitals, the moments are also split by the orbital of the sites of the trace,
+  // one row each. Their sum over the orbitals is the usual Gamma
+  Eigen::Array<T, -1, -1> gamma_orbitals;
+  Eigen::Matrix<T, -1, -1> tmp_orbitals;
+  if(orbitals)
+    gamma_orbitals = Eigen::Array<T, -1, -1 >::Zero(r.Orb, N_moments);
+  auto contract_moments = [&](int m){
+    if(!orbitals){
+      contract(kpm0_interior, &kpm1, tmp);
+      return;
+    }
+    contract_orbitals(kpm0_interior, &kpm1, tmp_orbitals);
+    gamma_orbitals.matrix().block(0, m, r.Orb, 2) += (tmp_orbitals - gamma_orbitals.matrix().block(0, m, r.Orb, 2))/value_type(average + 1);
+    tmp = tmp_orbitals.colwise().sum();
+  };
+
+  progress_start(name_dataset, long(NDisorder)*NRandomV);
+  for(int disorder = 0; disorder < NDisorder && !stop; disorder++){
+    seed_disorder(disorder);
     h.generate_disorder();
 
     for(unsigned it = 0; it < indices.size(); it++){
       h.build_velocity(indices.at(it), it);
     }
 
-    for(int randV = 0; randV < NRandomV; randV++){
+    for(int randV = 0; randV < NRandomV && !stop; randV++){
         
       kpm0.initiate_vector();			// original random vector
+      probe_vector(&kpm0);
       kpm1.set_index(0);
       kpm1.v.col(0) = kpm0.v.col(0);
       kpm1.Exchange_Boundaries();
 
-      if(indices.size() != 0)
-        generalized_velocity(&kpm1, &kpm0, indices, 0);
-
-      kpm0.v.col(0) = factor*kpm0.v.col(0); // This factor is due to the fact that this Velocity operator is not self-adjoint
-      kpm0.empty_ghosts(0);
-
-			
-      kpm1.template Multiply<0>();		
-      tmp.setZero();
-      for(std::size_t ii = 0; ii < r.Sized ; ii += r.Ld[0])
-        tmp += kpm0.v.block(ii,0, r.Ld[0], 1).adjoint() * kpm1.v.block(ii, 0, r.Ld[0], 2);
-
-      gamma.matrix().block(0,0,1,2) += (tmp - gamma.matrix().block(0,0,1,2))/value_type(average + 1);			
+      if(doubling){
+        Eigen::Matrix<T, -1, 1> mu;
+        doubling_moments(&kpm1, N_moments, mu);
+        gamma.matrix().row(0) += (mu.transpose() - gamma.matrix().row(0))/value_type(average + 1);
+        if(sampling)
+          sample.matrix().col(0) = mu;
+      } else {
+        if(indices.size() != 0)
+          generalized_velocity(&kpm1, &kpm0, indices, 0);
+
+        kpm0.v.col(0) = factor*kpm0.v.col(0); // This factor is due to the fact that this Velocity operator is not self-adjoint
+        gather_interior(&kpm0, kpm0_interior, 0);
+
+        cheb_iteration(&kpm1, 0);
+        contract_moments(0);
+
+        gamma.matrix().block(0,0,1,2) += (tmp - gamma.matrix().block(0,0,1,2))/value_type(average + 1);			
+        if(sampling)
+          sample.matrix().block(0,0,2,1) = tmp.transpose();
 	
-      for(int m = 2; m < N_moments; m += 2){
-        kpm1.template Multiply<1>();
-        kpm1.template Multiply<1>();
-        tmp.setZero();
-        for(std::size_t ii = 0; ii < r.Sized ; ii += r.Ld[0])
-          tmp += kpm0.v.block(ii,0, r.Ld[0], 1).adjoint() * kpm1.v.block(ii, 0, r.Ld[0], 2);
-
-        gamma.matrix().block(0, m,1,2) += (tmp - gamma.matrix().block(0,m,1,2))/value_type(average + 1);
-
+        for(int m = 2; m < N_moments; m += 2){
+          cheb_iteration(&kpm1, m - 1);
+          cheb_iteration(&kpm1, m);
+          contract_moments(m);
+
+          gamma.matrix().block(0, m,1,2) += (tmp - gamma.matrix().block(0,m,1,2))/value_type(average + 1);
+          if(sampling)
+            sample.matrix().block(m,0,2,1) = tmp.transpose();
+        }
+
+        // The random vector and the last two vectors of the recursion
+        if(resume.save){
+          keep_vector(&kpm0, 0);
+          keep_vector(&kpm1, 1 - kpm1.get_index());
+          keep_vector(&kpm1, kpm1.get_index());
+        }
       }
-  //std::cout << "got to line " << __LINE__ << " in file " << __FILE__ << "\n" << std::flush;
 
       average++;
+      progress_sample();
+      if(sampling)
+        stop = sample_converged(sample);
     }
   } 
+  progress_finish();
+
+  if(sampling)
+    finish_sampling();
 
   store_gamma1D(&gamma, name_dataset);
+  store_weight(name_dataset, average);
+  if(orbitals){
+    store_gamma1D(&gamma_orbitals, name_dataset + "Orbitals");
+    store_weight(name_dataset + "Orbitals", average);
+  }
+  if(resume.save)
+    store_resume(name_dataset, N_moments, NRandomV);
+  if(sampling)
+    store_sampling(name_dataset, 0, 1);
 }
 
 
@@ -93,13 +167,14 @@ template <typename T,unsigned D>
 void Simulation<T,D>::store_gamma1D(Eigen::Array<T, -1, -1> *gamma, 
                                   std::string name_dataset){
   debug_message("Entered store_gamma\n");
+  ScopedTimer timer(Diagnostics::STORE);
   // The whole purpose of this function is to take the Gamma matrix calculated by
 
 
 
   long int size_gamma = gamma->cols();
 #pragma omp master
-  Global.general_gamma = Eigen::Array<T, -1, -1 > :: Zero(1, size_gamma);
+  Global.general_gamma = Eigen::Array<T, -1, -1 > :: Zero(gamma->rows(), size_gamma);
 #pragma omp barrier
 #pragma omp critical
   Global.general_gamma += *gamma;
@@ -119,26 +194,26 @@ void Simulation<T,D>::store_gamma1D(Eigen::Array<T, -1, -1> *gamma,
 }
 
 
-template void Simulation<float ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<double ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<long double ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<float> ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<double> ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<long double> ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-
-template void Simulation<float ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<double ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<long double ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<float> ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<double> ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<long double> ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-
-template void Simulation<float ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<double ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<long double ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<float> ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<double> ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<long double> ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<float ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<double ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<long double ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<std::complex<float> ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<std::complex<double> ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<std::complex<long double> ,1u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+
+template void Simulation<float ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<double ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<long double ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<std::complex<float> ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<std::complex<double> ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<std::complex<long double> ,3u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+
+template void Simulation<float ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<double ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<long double ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<std::complex<float> ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<std::complex<double> ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
+template void Simulation<std::complex<long double> ,2u>::Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool, bool);
 
 
 template void Simulation<float ,1u>::store_gamma1D(Eigen::Array<float, -1, -1>* , std::string);
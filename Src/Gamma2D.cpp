@@ -11,6 +11,7 @@
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
 #include "Global.hpp"
+#include "Diagnostics.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
@@ -26,8 +27,8 @@ class KPM_Vector;
 
 template <typename T,unsigned D>
 void Simulation<T,D>::Gamma2D(int NRandomV, int NDisorder, std::vector<int> N_moments, 
-                              std::vector<std::vector<unsigned>> indices, std::string name_dataset){
-  Eigen::Matrix<T, MEMORY, MEMORY> tmp;
+                              std::vector<std::vector<unsigned>> indices, std::string name_dataset, bool symmetric){
+  Eigen::Matrix<T, -1, -1> tmp;
   // This function calculates all kinds of two-dimensional gamma matrices such
   // as Tr[V^a Tn v^b Tm] = G_nm
   //
@@ -47,6 +48,10 @@ void Simulation<T,D>::Gamma2D(int NRandomV, int NDisorder, std::vector<int> N_mo
   //
   // This function calculates all the kinds of one-dimensional Gamma matrices
   // such as Tr[Tn]    Tr[v^xx Tn]     etc
+  //
+  // When both velocities are the same (longitudinal conductivity), G_mn = factor*G_nm^*.
+  // With 'symmetric' set, only the blocks with n <= m are contracted and the
+  // others are obtained from this relation at the end
 
   typedef typename extract_value_type<T>::value_type value_type;
 
@@ -55,12 +60,19 @@ void Simulation<T,D>::Gamma2D(int NRandomV, int NDisorder, std::vector<int> N_mo
     num_velocities += indices.at(i).size();
   int factor = 1 - (num_velocities % 2)*2;
 
+  if(symmetric && (indices.at(0) != indices.at(1) || N_moments.at(0) != N_moments.at(1))){
+    verbose_message("Gamma2D: the symmetric mode needs equal directions and moments. Calculating the full matrix.\n");
+    symmetric = false;
+  }
+
   //  --------- INITIALIZATIONS --------------
-    
+
+  const int B = gamma_block(N_moments); // vectors in each block, MEMORY unless in the low-memory mode
   KPM_Vector<T,D> kpm0(1, *this);      // initial random vector
   KPM_Vector<T,D> kpm1(2, *this); // left vector that will be Chebyshev-iterated on
-  KPM_Vector<T,D> kpm2(MEMORY, *this); // right vector that will be Chebyshev-iterated on
-  KPM_Vector<T,D> kpm3(MEMORY, *this); // kpm1 multiplied by the velocity
+  KPM_Vector<T,D> kpm2(B, *this); // right vector that will be Chebyshev-iterated on
+  KPM_Vector<T,D> kpm3(1, *this);      // kpm1 multiplied by the velocity
+  Eigen::Matrix<T,-1,-1> kpm3_interior(r.Size, B); // the last B kpm3 vectors, without ghosts
 
   // initialize the local gamma matrix and set it to 0
   int size_gamma = 1;
@@ -72,75 +84,386 @@ void Simulation<T,D>::Gamma2D(int NRandomV, int NDisorder, std::vector<int> N_mo
     size_gamma *= N_moments.at(i);
   }
 
-  Eigen::Array<T, -1, -1> gamma = Eigen::Array<T, -1, -1 >::Zero(1, size_gamma);
+  // In the low-memory mode the threads add their moments to one matrix, G, instead of each
+  // keeping its own
+  const bool shared = share_gamma(N_moments);
+  Eigen::Array<T, -1, -1> gamma;
+  if(shared){
+#pragma omp master
+    Global.shared_gamma.assign(1, Eigen::Array<T, -1, -1 >::Zero(1, size_gamma));
+#pragma omp barrier
+  } else
+    gamma = Eigen::Array<T, -1, -1 >::Zero(1, size_gamma);
+  Eigen::Array<T, -1, -1> & G = shared ? Global.shared_gamma.at(0) : gamma;
+
+  // With a stopping rule, the matrix of each random vector is kept as one sample
+  const bool sampling = sampling_active();
+  Eigen::Array<T, -1, -1> sample;
+  if(sampling){
+    sample = Eigen::Array<T, -1, -1>::Zero(size_gamma, 1);
+    start_sampling(size_gamma, 1, {name_dataset});
+  }
+  bool stop = false;
  
   // finished initializations
 
 
     
     
-  // start the kpm iteration
+  // start the kpm iteration, or continue it from the last checkpoint
   long average = 0;
-  for(int disorder = 0; disorder < NDisorder; disorder++){
+  int disorder0 = 0, randV0 = 0;
+  if(!start_checkpoint(name_dataset, {&gamma}, disorder0, randV0, average))
+    return;
+  progress_start(name_dataset, long(NDisorder - disorder0)*NRandomV - randV0);
+  for(int disorder = disorder0; disorder < NDisorder && !stop; disorder++){
+    checkpoint_disorder();
     h.generate_disorder();
     for(unsigned it = 0; it < indices.size(); it++)
       h.build_velocity(indices.at(it), it);
-    for(int randV = 0; randV < NRandomV; randV++){
+    for(int randV = randV0; randV < NRandomV && !stop; randV++){
         
 
       kpm0.initiate_vector();			// original random vector. This sets the index to zero
+      probe_vector(&kpm0);
       kpm0.Exchange_Boundaries();
       kpm1.set_index(0);
 
       generalized_velocity(&kpm1, &kpm0, indices, 0);
+
+      // The shared average is updated here for all the threads, which then add their moments
+      if(shared){
+#pragma omp barrier
+#pragma omp master
+        G *= value_type(average)/value_type(average + 1);
+#pragma omp barrier
+      }
         
-      // run through the left loop MEMORY iterations at a time
-      for(int n = 0; n < N_moments.at(0); n+=MEMORY){
+      // run through the left loop B iterations at a time
+      for(int n = 0; n < N_moments.at(0); n+=B){
           
-        // Iterate MEMORY times. The first time this occurs, we must exclude the zeroth
+        // Iterate B times. The first time this occurs, we must exclude the zeroth
         // case, because it is already calculated, it's the identity
-        for(int i = n; i < n + MEMORY; i++){
+        for(int i = n; i < n + B; i++){
           if(i!=0){
             cheb_iteration(&kpm1, i-1);
           }
 
-          kpm3.set_index(i%MEMORY);
+          kpm3.set_index(0);
           generalized_velocity(&kpm3, &kpm1, indices, 1);
-          kpm3.empty_ghosts(i%MEMORY);
+          gather_interior(&kpm3, kpm3_interior, i%B);
         }
           
         // copy the |0> vector to |kpm2>
         kpm2.set_index(0);
         kpm2.v.col(0) = kpm0.v.col(0);
-        for(int m = 0; m < N_moments.at(1); m+=MEMORY){
+        for(int m = 0; m < N_moments.at(1); m+=B){
 
-          // iterate MEMORY times, just like before. No need to multiply by v here
-          for(int i = m; i < m + MEMORY; i++){
+          // iterate B times, just like before. No need to multiply by v here
+          for(int i = m; i < m + B; i++){
             if(i!=0){
               cheb_iteration(&kpm2, i-1);
             }
           }
-          //std::cout << "index2: " << kpm2.get_index() << "\n";
+          // The blocks below the diagonal are recovered from the symmetry
+          if(symmetric && m < n)
+            continue;
+
           // Finally, do the matrix product and store the result in the Gamma matrix
-          tmp.setZero();
-          for(std::size_t ii = 0; ii < r.Sized ; ii += r.Ld[0])
-            tmp += kpm3.v.block(ii,0, r.Ld[0], MEMORY).adjoint() * kpm2.v.block(ii, 0, r.Ld[0], MEMORY);
+          contract(kpm3_interior, &kpm2, tmp);
           T flatten;
           long int ind;
-          for(int j = 0; j < MEMORY; j++)
-            for(int i = 0; i < MEMORY; i++){
-              flatten = tmp(i,j);
-              ind = (m+j)*N_moments.at(0) + n+i;
-              gamma(ind) += (flatten - gamma(ind))/value_type(average + 1);			
-            }
+          if(shared){
+#pragma omp critical (shared_gamma)
+            for(int j = 0; j < B; j++)
+              for(int i = 0; i < B; i++)
+                G((m+j)*N_moments.at(0) + n+i) += tmp(i,j)/value_type(average + 1);
+          } else {
+            for(int j = 0; j < B; j++)
+              for(int i = 0; i < B; i++){
+                flatten = tmp(i,j);
+                ind = (m+j)*N_moments.at(0) + n+i;
+                gamma(ind) += (flatten - gamma(ind))/value_type(average + 1);
+                if(sampling)
+                  sample(ind) = T(factor)*flatten;
+              }
+          }
         }
       }
       average++;
+      progress_sample();
+      save_checkpoint(disorder, randV + 1, average, {&gamma});
+      if(sampling){
+        project_sample(sample, 0, N_moments.at(0), factor, symmetric);
+        stop = sample_converged(sample);
+      }
     }
+    randV0 = 0;
   } 
-  gamma = gamma*factor;
+  progress_finish();
+  if(sampling)
+    finish_sampling();
+  stop_checkpoint();
+
+  // The shared matrix is completed by the master, once all the threads have added to it
+  if(shared){
+#pragma omp barrier
+  }
+  if(!shared || r.thread_id == 0){
+    if(symmetric){
+      Eigen::Map<Eigen::Array<T, -1, -1>> M(G.data(), N_moments.at(0), N_moments.at(1));
+      for(int m = 0; m < N_moments.at(1); m++)
+        for(int n = 0; n < N_moments.at(0); n++)
+          if(n/B > m/B)
+            M(n,m) = T(factor)*myconj(M(m,n));
+    }
+    G *= T(factor);
+  }
             
-  store_gamma(&gamma, N_moments, indices, name_dataset);
+  if(shared)
+    store_shared_gamma(G, N_moments, factor, name_dataset);
+  else
+    store_gamma(&gamma, N_moments, indices, name_dataset);
+  store_weight(name_dataset, average);
+  if(sampling)
+    store_sampling(name_dataset, 0, N_moments.at(0));
+  finish_checkpoint(name_dataset);
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::Gamma2D(int NRandomV, int NDisorder, std::vector<int> N_moments, 
+                              std::vector<std::vector<std::vector<unsigned>>> components,
+                              std::vector<std::string> name_datasets, bool symmetric, std::string name_dos){
+  // Calculates several two-dimensional Gamma matrices Tr[V^a_c Tn V^b_c Tm] at once,
+  // one for each component c, with the same disorder realisations and random vectors.
+  // The left vectors V^b_c Tn V^a_c|r> of all the components are packed side by side,
+  // so each block of right vectors Tm|r> is iterated only once and contracted with a
+  // single GEMM. The left Chebyshev iteration is shared by the components with the
+  // same V^a. Each matrix is stored as in the single component version
+  //
+  // If name_dos is not empty, |r> is packed after the left vectors and the DOS moments
+  // <r|Tm|r> are obtained from the first block of n, with the same random vectors
+
+  typedef typename extract_value_type<T>::value_type value_type;
+  const int N_comp = components.size();
+
+  for(int i = 0; i < 2; i++)
+    if(N_moments.at(i) % 2 != 0){
+      std::cout << "The number of moments must be an even number, due to limitations of the program. Aborting\n";
+      exit(1);
+    }
+
+  // Each different velocity operator gets its own slot in the Hamiltonian. left and right
+  // are the slots of V^a_c and V^b_c, and chain is the left iteration used by component c
+  std::vector<std::vector<unsigned>> slots;
+  std::vector<int> left(N_comp), right(N_comp), chain(N_comp), factor(N_comp);
+  std::vector<int> chain_slot;
+  for(int c = 0; c < N_comp; c++){
+    for(int k = 0; k < 2; k++){
+      std::vector<unsigned> & dir = components.at(c).at(k);
+      int s = std::find(slots.begin(), slots.end(), dir) - slots.begin();
+      if(s == int(slots.size()))
+        slots.push_back(dir);
+      (k == 0 ? left : right).at(c) = s;
+    }
+    chain.at(c) = std::find(chain_slot.begin(), chain_slot.end(), left.at(c)) - chain_slot.begin();
+    if(chain.at(c) == int(chain_slot.size()))
+      chain_slot.push_back(left.at(c));
+
+    int num_velocities = components.at(c).at(0).size() + components.at(c).at(1).size();
+    factor.at(c) = 1 - (num_velocities % 2)*2;
+
+    if(symmetric && left.at(c) != right.at(c)){
+      verbose_message("Gamma2D: the symmetric mode needs equal directions in every component. Calculating the full matrices.\n");
+      symmetric = false;
+    }
+  }
+  if(symmetric && N_moments.at(0) != N_moments.at(1)){
+    verbose_message("Gamma2D: the symmetric mode needs equal numbers of moments. Calculating the full matrices.\n");
+    symmetric = false;
+  }
+  
+  // velocity_indices[s] is only used by generalized_velocity to check that slot s is not the identity
+  std::vector<std::vector<unsigned>> velocity_indices = slots;
+
+  //  --------- INITIALIZATIONS --------------
+  
+  const int B = gamma_block(N_moments); // vectors in each block, MEMORY unless in the low-memory mode
+  KPM_Vector<T,D> kpm0(1, *this);      // initial random vector
+  std::vector<KPM_Vector<T,D>*> kpm1(chain_slot.size()); // left vectors that will be Chebyshev-iterated on
+  for(unsigned l = 0; l < chain_slot.size(); l++)
+    kpm1.at(l) = new KPM_Vector<T,D>(2, *this);
+  KPM_Vector<T,D> kpm2(B, *this); // right vector that will be Chebyshev-iterated on
+  KPM_Vector<T,D> kpm3(1, *this);      // kpm1 multiplied by the velocity
+  const bool harvest_dos = name_dos != "";
+  Eigen::Matrix<T,-1,-1> kpm3_interior(r.Size, B*N_comp + harvest_dos); // the last B kpm3 vectors of each component
+  Eigen::Matrix<T,-1,-1> tmp;
+  
+  long size_gamma = long(N_moments.at(0))*N_moments.at(1);
+  // In the low-memory mode the threads add their moments to the matrices G of all of them
+  const bool shared = share_gamma(N_moments);
+  std::vector<Eigen::Array<T, -1, -1>> gamma(N_comp);
+  if(shared){
+#pragma omp master
+    Global.shared_gamma.assign(N_comp, Eigen::Array<T, -1, -1 >::Zero(1, size_gamma));
+#pragma omp barrier
+  } else
+    gamma.assign(N_comp, Eigen::Array<T, -1, -1 >::Zero(1, size_gamma));
+  std::vector<Eigen::Array<T, -1, -1>> & G = shared ? Global.shared_gamma : gamma;
+  Eigen::Array<T, -1, -1> mu = Eigen::Array<T, -1, -1 >::Zero(1, N_moments.at(1));
+
+  // With a stopping rule, the matrices of each random vector are kept as one sample,
+  // with one column for each component
+  const bool sampling = sampling_active();
+  Eigen::Array<T, -1, -1> sample;
+  if(sampling){
+    sample = Eigen::Array<T, -1, -1>::Zero(size_gamma, N_comp);
+    start_sampling(size_gamma, N_comp, name_datasets);
+  }
+  bool stop = false;
+  
+  // finished initializations
+  
+  
+  // start the kpm iteration, or continue it from the last checkpoint
+  long average = 0;
+  int disorder0 = 0, randV0 = 0;
+  std::vector<Eigen::Array<T, -1, -1>*> partial = {&mu};
+  for(int c = 0; c < N_comp; c++)
+    partial.push_back(&gamma.at(c));
+  if(!start_checkpoint(name_datasets.at(0), partial, disorder0, randV0, average)){
+    for(unsigned l = 0; l < chain_slot.size(); l++)
+      delete kpm1.at(l);
+    return;
+  }
+  progress_start(name_datasets.at(0), long(NDisorder - disorder0)*NRandomV - randV0);
+  for(int disorder = disorder0; disorder < NDisorder && !stop; disorder++){
+    checkpoint_disorder();
+    h.generate_disorder();
+    for(unsigned s = 0; s < slots.size(); s++)
+      h.build_velocity(slots.at(s), s);
+    for(int randV = randV0; randV < NRandomV && !stop; randV++){
+      
+      kpm0.initiate_vector();			// original random vector. This sets the index to zero
+      probe_vector(&kpm0);
+      kpm0.Exchange_Boundaries();
+      for(unsigned l = 0; l < chain_slot.size(); l++){
+        kpm1.at(l)->set_index(0);
+        velocity_or_copy(kpm1.at(l), &kpm0, velocity_indices, chain_slot.at(l));
+      }
+      if(harvest_dos)
+        gather_interior(&kpm0, kpm3_interior, B*N_comp);
+
+      // The shared averages are updated here for all the threads, which then add their moments
+      if(shared){
+#pragma omp barrier
+#pragma omp master
+        for(int c = 0; c < N_comp; c++)
+          G.at(c) *= value_type(average)/value_type(average + 1);
+#pragma omp barrier
+      }
+      
+      // run through the left loop B iterations at a time
+      for(int n = 0; n < N_moments.at(0); n+=B){
+        
+        for(int i = n; i < n + B; i++){
+          for(unsigned l = 0; l < chain_slot.size(); l++)
+            if(i!=0)
+              cheb_iteration(kpm1.at(l), i-1);
+          
+          for(int c = 0; c < N_comp; c++){
+            kpm3.set_index(0);
+            velocity_or_copy(&kpm3, kpm1.at(chain.at(c)), velocity_indices, right.at(c));
+            gather_interior(&kpm3, kpm3_interior, c*B + i%B);
+          }
+        }
+        
+        // copy the |0> vector to |kpm2>
+        kpm2.set_index(0);
+        kpm2.v.col(0) = kpm0.v.col(0);
+        for(int m = 0; m < N_moments.at(1); m+=B){
+          
+          for(int i = m; i < m + B; i++){
+            if(i!=0){
+              cheb_iteration(&kpm2, i-1);
+            }
+          }
+          // The blocks below the diagonal are recovered from the symmetry
+          if(symmetric && m < n)
+            continue;
+          
+          // One product for all the components
+          contract(kpm3_interior, &kpm2, tmp);
+          long int ind;
+          if(shared){
+#pragma omp critical (shared_gamma)
+            for(int c = 0; c < N_comp; c++)
+              for(int j = 0; j < B; j++)
+                for(int i = 0; i < B; i++)
+                  G.at(c)((m+j)*N_moments.at(0) + n+i) += tmp(c*B + i, j)/value_type(average + 1);
+          } else {
+            for(int c = 0; c < N_comp; c++)
+              for(int j = 0; j < B; j++)
+                for(int i = 0; i < B; i++){
+                  ind = (m+j)*N_moments.at(0) + n+i;
+                  gamma.at(c)(ind) += (tmp(c*B + i, j) - gamma.at(c)(ind))/value_type(average + 1);
+                  if(sampling)
+                    sample(ind, c) = T(factor.at(c))*tmp(c*B + i, j);
+                }
+          }
+          if(harvest_dos && n == 0)
+            for(int j = 0; j < B; j++)
+              mu(m+j) += (tmp(B*N_comp, j) - mu(m+j))/value_type(average + 1);
+        }
+      }
+      average++;
+      progress_sample();
+      save_checkpoint(disorder, randV + 1, average, partial);
+      if(sampling){
+        for(int c = 0; c < N_comp; c++)
+          project_sample(sample, c, N_moments.at(0), factor.at(c), symmetric);
+        stop = sample_converged(sample);
+      }
+    }
+    randV0 = 0;
+  }
+  progress_finish();
+  if(sampling)
+    finish_sampling();
+  stop_checkpoint();
+  
+  for(unsigned l = 0; l < chain_slot.size(); l++)
+    delete kpm1.at(l);
+  
+  // The shared matrices are completed by the master, once all the threads have added to them
+  if(shared){
+#pragma omp barrier
+  }
+  for(int c = 0; c < N_comp; c++){
+    if(!shared || r.thread_id == 0){
+      if(symmetric){
+        Eigen::Map<Eigen::Array<T, -1, -1>> M(G.at(c).data(), N_moments.at(0), N_moments.at(1));
+        for(int m = 0; m < N_moments.at(1); m++)
+          for(int n = 0; n < N_moments.at(0); n++)
+            if(n/B > m/B)
+              M(n,m) = T(factor.at(c))*myconj(M(m,n));
+      }
+      G.at(c) *= T(factor.at(c));
+    }
+    if(shared)
+      store_shared_gamma(G.at(c), N_moments, factor.at(c), name_datasets.at(c));
+    else
+      store_gamma(&gamma.at(c), N_moments, components.at(c), name_datasets.at(c));
+    store_weight(name_datasets.at(c), average);
+    if(sampling)
+      store_sampling(name_datasets.at(c), c, N_moments.at(0));
+  }
+  if(harvest_dos){
+    store_gamma1D(&mu, name_dos);
+    store_weight(name_dos, average);
+  }
+  finish_checkpoint(name_datasets.at(0));
 }
 
 
@@ -150,6 +473,7 @@ template <typename T,unsigned D>
 void Simulation<T,D>::store_gamma(Eigen::Array<T, -1, -1> *gamma, std::vector<int> N_moments, 
                                   std::vector<std::vector<unsigned>> indices, std::string name_dataset){
   debug_message("Entered store_gamma\n");
+  ScopedTimer timer(Diagnostics::STORE);
   // The whole purpose of this function is to take the Gamma matrix calculated by
 
 
@@ -169,7 +493,7 @@ void Simulation<T,D>::store_gamma(Eigen::Array<T, -1, -1> *gamma, std::vector<in
 		
   switch(dim){
   case 2: {
-    Eigen::Array<T,-1,-1> general_gamma = Eigen::Map<Eigen::Array<T,-1,-1>>(gamma->data(), N_moments.at(0), N_moments.at(1));
+    Eigen::Map<Eigen::Array<T,-1,-1>> general_gamma(gamma->data(), N_moments.at(0), N_moments.at(1));
 #pragma omp master
     Global.general_gamma = Eigen::Array<T, -1, -1 > :: Zero(N_moments.at(0), N_moments.at(1));
 #pragma omp barrier
@@ -179,7 +503,7 @@ void Simulation<T,D>::store_gamma(Eigen::Array<T, -1, -1> *gamma, std::vector<in
     break;
   }
   case 1: {
-    Eigen::Array<T,-1,-1> general_gamma = Eigen::Map<Eigen::Array<T,-1,-1>>(gamma->data(), 1, size_gamma);
+    Eigen::Map<Eigen::Array<T,-1,-1>> general_gamma(gamma->data(), 1, size_gamma);
 #pragma omp master
     Global.general_gamma = Eigen::Array<T, -1, -1 > :: Zero(1, size_gamma);
 #pragma omp barrier
@@ -207,27 +531,78 @@ void Simulation<T,D>::store_gamma(Eigen::Array<T, -1, -1> *gamma, std::vector<in
   debug_message("Left store_gamma\n");
 }
 
+template <typename T,unsigned D>
+void Simulation<T,D>::store_shared_gamma(Eigen::Array<T, -1, -1> & gamma, std::vector<int> N_moments, 
+                                         int factor, std::string name_dataset){
+  debug_message("Entered store_shared_gamma\n");
+  ScopedTimer timer(Diagnostics::STORE);
+  // Same as store_gamma for the matrix shared by the threads in the low-memory mode. It already
+  // holds the sum of all of them, so it is made hermitian (or anti-hermitian) in place, without
+  // the copy of each thread and the one in Global.general_gamma
+#pragma omp barrier
+#pragma omp master
+  {
+    Eigen::Map<Eigen::Array<T, -1, -1>> M(gamma.data(), N_moments.at(0), N_moments.at(1));
+    for(int m = 0; m < N_moments.at(1); m++)
+      for(int n = 0; n <= m; n++){
+        T a = M(n,m), b = M(m,n);
+        M(n,m) = (a + T(factor)*myconj(b))/T(2);
+        M(m,n) = (b + T(factor)*myconj(a))/T(2);
+      }
+    gamma.resize(N_moments.at(0), N_moments.at(1));
+    
+    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+    write_hdf5(gamma, file, name_dataset);
+    delete file;
+    gamma = Eigen::Array<T, -1, -1>();
+  }
+#pragma omp barrier
+  debug_message("Left store_shared_gamma\n");
+}
+
+
+template void Simulation<float ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<double ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<long double ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<std::complex<float> ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<std::complex<double> ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<std::complex<long double> ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+
+template void Simulation<float ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<double ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<long double ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<std::complex<float> ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<std::complex<double> ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<std::complex<long double> ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
 
-template void Simulation<float ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<double ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<long double ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<float> ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<double> ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<long double> ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<float ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<double ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<long double ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<std::complex<float> ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<std::complex<double> ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
+template void Simulation<std::complex<long double> ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string, bool);
 
-template void Simulation<float ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<double ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<long double ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<float> ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<double> ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<long double> ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
 
-template void Simulation<float ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<double ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<long double ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<float> ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<double> ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
-template void Simulation<std::complex<long double> ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<float ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<double ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<long double ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<std::complex<float> ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<std::complex<double> ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<std::complex<long double> ,1u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+
+template void Simulation<float ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<double ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<long double ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<std::complex<float> ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<std::complex<double> ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<std::complex<long double> ,3u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+
+template void Simulation<float ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<double ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<long double ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<std::complex<float> ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<std::complex<double> ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
+template void Simulation<std::complex<long double> ,2u>::Gamma2D(int, int, std::vector<int>, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool, std::string);
 
 
 
@@ -254,3 +629,24 @@ template void Simulation<long double ,3u>::store_gamma(Eigen::Array<long double,
 template void Simulation<std::complex<float> ,3u>::store_gamma(Eigen::Array<std::complex<float>, -1, -1>* , std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
 template void Simulation<std::complex<double> ,3u>::store_gamma(Eigen::Array<std::complex<double>, -1, -1>* , std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
 template void Simulation<std::complex<long double> ,3u>::store_gamma(Eigen::Array<std::complex<long double>, -1, -1>* , std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+
+template void Simulation<float ,1u>::store_shared_gamma(Eigen::Array<float, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<double ,1u>::store_shared_gamma(Eigen::Array<double, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<long double ,1u>::store_shared_gamma(Eigen::Array<long double, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<std::complex<float> ,1u>::store_shared_gamma(Eigen::Array<std::complex<float>, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<std::complex<double> ,1u>::store_shared_gamma(Eigen::Array<std::complex<double>, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<std::complex<long double> ,1u>::store_shared_gamma(Eigen::Array<std::complex<long double>, -1, -1> &, std::vector<int>, int, std::string);
+
+template void Simulation<float ,2u>::store_shared_gamma(Eigen::Array<float, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<double ,2u>::store_shared_gamma(Eigen::Array<double, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<long double ,2u>::store_shared_gamma(Eigen::Array<long double, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<std::complex<float> ,2u>::store_shared_gamma(Eigen::Array<std::complex<float>, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<std::complex<double> ,2u>::store_shared_gamma(Eigen::Array<std::complex<double>, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<std::complex<long double> ,2u>::store_shared_gamma(Eigen::Array<std::complex<long double>, -1, -1> &, std::vector<int>, int, std::string);
+
+template void Simulation<float ,3u>::store_shared_gamma(Eigen::Array<float, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<double ,3u>::store_shared_gamma(Eigen::Array<double, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<long double ,3u>::store_shared_gamma(Eigen::Array<long double, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<std::complex<float> ,3u>::store_shared_gamma(Eigen::Array<std::complex<float>, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<std::complex<double> ,3u>::store_shared_gamma(Eigen::Array<std::complex<double>, -1, -1> &, std::vector<int>, int, std::string);
+template void Simulation<std::complex<long double> ,3u>::store_shared_gamma(Eigen::Array<std::complex<long double>, -1, -1> &, std::vector<int>, int, std::string);
@@ -11,6 +11,7 @@
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
 #include "Global.hpp"
+#include "Diagnostics.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
@@ -26,7 +27,7 @@ class KPM_Vector;
 template <typename T,unsigned D>
 void Simulation<T,D>::Gamma3D(int NRandomV, int NDisorder, std::vector<int> N_moments, 
                               std::vector<std::vector<unsigned>> indices, std::string name_dataset){
-  Eigen::Matrix<T, MEMORY, MEMORY> tmp;
+  Eigen::Matrix<T, -1, -1> tmp;
   // This calculates all the kinds of three-dimensional gamma matrices
   // such as Tr[v^a Tn v^b Tm v^c Tp] = G_nmp. The output is a 2D matrix 
   // organized as follows:
@@ -68,6 +69,10 @@ void Simulation<T,D>::Gamma3D(int NRandomV, int NDisorder, std::vector<int> N_mo
   // easy to use up enormous ammounts of memory. This is why the matrix is calculated
   // in blocks
   //
+  // Each thread keeps its partial (n,m) blocks for the current p in its own column
+  // of Global.smaller_gamma. These are summed over the threads once per p, each
+  // thread reducing a different share of the entries
+  //
     
   typedef typename extract_value_type<T>::value_type value_type;
     
@@ -75,7 +80,8 @@ void Simulation<T,D>::Gamma3D(int NRandomV, int NDisorder, std::vector<int> N_mo
     
   KPM_Vector<T,D> kpm0(1, *this);           // initial random vector
   KPM_Vector<T,D> kpm_Vn(2, *this);          // left vector that will be Chebyshev-iterated on
-  KPM_Vector<T,D> kpm_VnV(MEMORY, *this);    // kpmL multiplied by the velocity
+  KPM_Vector<T,D> kpm_VnV(1, *this);         // kpmL multiplied by the velocity
+  Eigen::Matrix<T,-1,-1> kpm_VnV_interior(r.Size, MEMORY); // the last MEMORY kpm_VnV vectors, without ghosts
   KPM_Vector<T,D> kpm_p(2, *this);          // right-most vector that will be Chebyshev-iterated on
   KPM_Vector<T,D> kpm_pVm(MEMORY, *this);         // middle vector that will be Chebyshev-iterated on
     
@@ -91,25 +97,39 @@ void Simulation<T,D>::Gamma3D(int NRandomV, int NDisorder, std::vector<int> N_mo
 #pragma omp master
   {
     Global.general_gamma = Eigen::Array<T, -1, -1>::Zero(1, size_gamma);
-    Global.smaller_gamma = Eigen::Array<T, -1, -1>::Zero(MEMORY, MEMORY);
+    Global.smaller_gamma = Eigen::Array<T, -1, -1>::Zero(MEMORY*N_moments.at(1), r.n_threads);
   }
 #pragma omp barrier
+  Eigen::Map<Eigen::Array<T, -1, -1>> partial_gamma(Global.smaller_gamma.col(r.thread_id).data(), MEMORY, N_moments.at(1));
+  const long rows_gamma = MEMORY*N_moments.at(1);
+  const long row0 = rows_gamma*r.thread_id/r.n_threads;
+  const long row1 = rows_gamma*(r.thread_id + 1)/r.n_threads;
     
   // finished initializations
     
-  // start the kpm iteration
+  // start the kpm iteration, or continue it from the last checkpoint. The average is shared
+  // by the threads, so the master keeps it
   long average = 0;
-  for(int disorder = 0; disorder < NDisorder; disorder++){
+  int disorder0 = 0, randV0 = 0;
+  std::vector<Eigen::Array<T, -1, -1>*> partial;
+  if(r.thread_id == 0)
+    partial.push_back(&Global.general_gamma);
+  if(!start_checkpoint(name_dataset, partial, disorder0, randV0, average))
+    return;
+  progress_start(name_dataset, long(NDisorder - disorder0)*NRandomV - randV0);
+  for(int disorder = disorder0; disorder < NDisorder; disorder++){
 
     // Distribute the disorder and update the velocity matrices
+    checkpoint_disorder();
     h.generate_disorder();
     for(unsigned it = 0; it < indices.size(); it++)
       h.build_velocity(indices.at(it), it);
 
-    for(int randV = 0; randV < NRandomV; randV++){
+    for(int randV = randV0; randV < NRandomV; randV++){
         
         
       kpm0.initiate_vector();			// original random vector. This sets the index to zero
+      probe_vector(&kpm0);
       kpm0.Exchange_Boundaries();
       kpm_Vn.set_index(0);
 
@@ -121,9 +141,9 @@ void Simulation<T,D>::Gamma3D(int NRandomV, int NDisorder, std::vector<int> N_mo
         for(int ni = n; ni < n + MEMORY; ni++){
           if(ni!=0) cheb_iteration(&kpm_Vn, ni-1);
            
-          kpm_VnV.set_index(ni%MEMORY);
+          kpm_VnV.set_index(0);
           generalized_velocity(&kpm_VnV, &kpm_Vn, indices, 1);
-          kpm_VnV.empty_ghosts(ni%MEMORY);
+          gather_interior(&kpm_VnV, kpm_VnV_interior, ni%MEMORY);
         }
           
         // Calculation of the right kpm vector
@@ -138,48 +158,43 @@ void Simulation<T,D>::Gamma3D(int NRandomV, int NDisorder, std::vector<int> N_mo
             for(int mi = m; mi < m + MEMORY; mi++)
               if(mi != 0) cheb_iteration(&kpm_pVm, mi-1);
 
-            tmp.setZero();
-            for(std::size_t ii = 0; ii < r.Sized ; ii += r.Ld[0])
-              tmp += kpm_VnV.v.block(ii,0, r.Ld[0], MEMORY).adjoint() * kpm_pVm.v.block(ii, 0, r.Ld[0], MEMORY);
-              
-#pragma omp master
-            {
-              Global.smaller_gamma.setZero();
-            }
-#pragma omp barrier
-#pragma omp critical
-            {
-              Global.smaller_gamma += tmp.array();
-            }
-#pragma omp barrier
-#pragma omp master
-            {
-              long int index;
-              for(int i = 0; i < MEMORY; i++)
-                for(int j = 0; j < MEMORY; j++){
-                  index = p*N_moments.at(1)*N_moments.at(0) + (m+j)*N_moments.at(0) + n+i;
-                  Global.general_gamma(index) += (Global.smaller_gamma(i, j) - Global.general_gamma(index))/value_type(average + 1);
-                }
-            }
+            contract(kpm_VnV_interior, &kpm_pVm, tmp);
+            partial_gamma.block(0, m, MEMORY, MEMORY) = tmp.array();
+          }
+
+          // Sum the partial blocks of all the threads and update the average
 #pragma omp barrier
+          for(long k = row0; k < row1; k++){
+            long int index = p*N_moments.at(1)*N_moments.at(0) + (k/MEMORY)*N_moments.at(0) + n + k%MEMORY;
+            T sum = Global.smaller_gamma.row(k).sum();
+            Global.general_gamma(index) += (sum - Global.general_gamma(index))/value_type(average + 1);
           }
+#pragma omp barrier
         }
       }
       average++;
+      progress_sample();
+      save_checkpoint(disorder, randV + 1, average, partial);
     }
+    randV0 = 0;
   } 
+  progress_finish();
+  stop_checkpoint();
 #pragma omp master
   {
     store_gamma3D(&Global.general_gamma, N_moments, indices, name_dataset);
     
   }
 #pragma omp barrier
+  store_weight(name_dataset, average);
+  finish_checkpoint(name_dataset);
 }
 
 template <typename T,unsigned D>
 void Simulation<T,D>::store_gamma3D(Eigen::Array<T, -1, -1> *gamma, std::vector<int> N_moments, 
                                     std::vector<std::vector<unsigned>> indices, std::string name_dataset){
   debug_message("Entered store_gamma3d\n");
+  ScopedTimer timer(Diagnostics::STORE);
   // The whole purpose of this function is to take the Gamma matrix calculated by
   // Gamma3D, check if there are any symmetries among the 
   // matrix elements and then store the matrix in an HDF file.
@@ -199,8 +214,7 @@ void Simulation<T,D>::store_gamma3D(Eigen::Array<T, -1, -1> *gamma, std::vector<
   int N0 = N_moments.at(0);
   int N1 = N_moments.at(1);
   int N2 = N_moments.at(2);
-  Eigen::Array<T,-1,-1> general_gamma;
-  general_gamma = Eigen::Map<Eigen::Array<T,-1,-1>>(gamma->data(), N0*N1, N2);
+  Eigen::Map<Eigen::Array<T,-1,-1>> general_gamma(gamma->data(), N0*N1, N2);
   Eigen::Array<T,-1,-1> storage_gamma; 
   storage_gamma = Eigen::Array<T,-1,-1>::Zero(N0*N1, N2);
     
@@ -0,0 +1,319 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Global.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+template <typename T, unsigned D>
+class Hamiltonian;
+template <typename T, unsigned D>
+class KPM_Vector;
+#include "Simulation.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::GammaFused(int NRandomV, int NDisorder, int N_moments,
+                                 std::vector<std::vector<std::vector<unsigned>>> objects,
+                                 std::vector<std::string> name_datasets){
+  Eigen::Matrix<T, -1, -1> tmp;
+  // Calculates several Gamma matrices of one, two and three indices in a single sweep,
+  // all of them with N_moments in every index. Each disorder realisation and random
+  // vector is generated once and every object is obtained from the same recursions:
+  //
+  //   Tr[V^a Tn]                 from <r|V^a Tp|r>, harvested in the first block of n
+  //   Tr[V^a Tn V^b Tm]          as in Gamma2D
+  //   Tr[V^a Tn V^b Tm V^c Tp]   as in Gamma3D
+  //
+  // The left vectors Tn V^a|r> are shared by the objects with the same V^a, and the
+  // right vectors Tp|r> are shared by all of them. For each block of n, the left
+  // vectors of the two-index objects are packed side by side and contracted with a
+  // single GEMM for every block of Tp|r>. The three-index objects with the same V^c share
+  // the vectors Tm V^c Tp|r>. Each object is stored exactly like the single versions do
+  //
+  // The right vectors are recalculated for every block of n, so the blocks of n are as
+  // large as MEMORY_BUDGET allows, in multiples of MEMORY. With a single block, the
+  // three-index objects need N^2 instead of N^3/MEMORY Chebyshev iterations
+
+  typedef typename extract_value_type<T>::value_type value_type;
+  const int N = N_moments;
+  if(N % 2 != 0){
+    std::cout << "The number of moments must be an even number, due to limitations of the program. Aborting\n";
+    exit(1);
+  }
+
+  // Each different velocity operator gets its own slot in the Hamiltonian
+  std::vector<std::vector<unsigned>> slots;
+  std::vector<std::vector<int>> slot(objects.size());
+  for(unsigned q = 0; q < objects.size(); q++)
+    for(unsigned k = 0; k < objects.at(q).size(); k++){
+      std::vector<unsigned> & dir = objects.at(q).at(k);
+      int s = std::find(slots.begin(), slots.end(), dir) - slots.begin();
+      if(s == int(slots.size()))
+        slots.push_back(dir);
+      slot.at(q).push_back(s);
+    }
+
+  // Sort the objects by their number of indices. chain is the left iteration of each
+  // object and group the set of vectors Tm V^c Tp|r> used by each three-index object
+  std::vector<int> obj1, obj2, obj3, chain(objects.size(), -1), group(objects.size(), -1), col(objects.size());
+  std::vector<int> chain_slot, group_slot, group_size;
+  for(unsigned q = 0; q < objects.size(); q++){
+    int dim = objects.at(q).size();
+    if(dim == 1){
+      obj1.push_back(q);
+      continue;
+    }
+    if(dim != 2 && dim != 3){
+      std::cout << "GammaFused only calculates Gamma matrices with up to three indices. Exiting.\n";
+      exit(1);
+    }
+    (dim == 2 ? obj2 : obj3).push_back(q);
+    chain.at(q) = std::find(chain_slot.begin(), chain_slot.end(), slot.at(q).at(0)) - chain_slot.begin();
+    if(chain.at(q) == int(chain_slot.size()))
+      chain_slot.push_back(slot.at(q).at(0));
+    if(dim == 3){
+      group.at(q) = std::find(group_slot.begin(), group_slot.end(), slot.at(q).at(2)) - group_slot.begin();
+      if(group.at(q) == int(group_slot.size())){
+        group_slot.push_back(slot.at(q).at(2));
+        group_size.push_back(0);
+      }
+      col.at(q) = group_size.at(group.at(q));
+      group_size.at(group.at(q))++;
+    }
+  }
+
+  // Number of moments n in each block of the left vectors
+  const int n_left = obj2.size() + obj3.size();
+  int NB = n_left > 0 ? plan_stored_vectors(N*n_left)/n_left : N;
+  NB = std::min(N, std::max(int(MEMORY), NB - NB%MEMORY));
+  verbose_message("GammaFused: " << (N + NB - 1)/NB << " block(s) of left vectors.\n");
+
+  for(unsigned q = 0; q < objects.size(); q++)
+    if(group.at(q) != -1)
+      col.at(q) *= NB;
+  for(unsigned k = 0; k < obj2.size(); k++)
+    col.at(obj2.at(k)) = k*NB;
+  for(unsigned k = 0; k < obj1.size(); k++)
+    col.at(obj1.at(k)) = obj2.size()*NB + k;
+
+  std::vector<int> factor(objects.size());
+  for(unsigned q = 0; q < objects.size(); q++){
+    int num_velocities = 0;
+    for(unsigned k = 0; k < objects.at(q).size(); k++)
+      num_velocities += objects.at(q).at(k).size();
+    factor.at(q) = 1 - (num_velocities % 2)*2;
+  }
+
+  //  --------- INITIALIZATIONS --------------
+
+  KPM_Vector<T,D> kpm0(1, *this);      // initial random vector
+  std::vector<KPM_Vector<T,D>*> kpm_Vn(chain_slot.size()); // left vectors that will be Chebyshev-iterated on
+  for(unsigned l = 0; l < chain_slot.size(); l++)
+    kpm_Vn.at(l) = new KPM_Vector<T,D>(2, *this);
+  KPM_Vector<T,D> kpm_p(MEMORY, *this); // right vector that will be Chebyshev-iterated on
+  KPM_Vector<T,D> kpm_VnV(1, *this);    // left vectors multiplied by a velocity
+  std::vector<KPM_Vector<T,D>*> kpm_pVm(group_slot.size()); // middle vectors of the three-index objects
+  for(unsigned g = 0; g < group_slot.size(); g++)
+    kpm_pVm.at(g) = new KPM_Vector<T,D>(MEMORY, *this);
+
+  // Left vectors without the ghosts. The two-index objects are followed by one column
+  // for each one-index object. The three-index objects have one matrix for each group
+  Eigen::Matrix<T,-1,-1> left2(r.Size, obj2.size()*NB + obj1.size());
+  std::vector<Eigen::Matrix<T,-1,-1>> left3(group_slot.size());
+  for(unsigned g = 0; g < group_slot.size(); g++)
+    left3.at(g).resize(r.Size, group_size.at(g)*NB);
+
+  std::vector<Eigen::Array<T, -1, -1>> gamma(objects.size());
+  for(unsigned q = 0; q < objects.size(); q++)
+    if(objects.at(q).size() < 3)
+      gamma.at(q) = Eigen::Array<T, -1, -1>::Zero(1, objects.at(q).size() == 1 ? N : N*N);
+
+  // The three-index objects are averaged over the threads once per p, as in Gamma3D
+  const long size_gamma3 = long(N)*N*N;
+  const long rows_gamma = obj3.size()*NB*N;
+  const long row0 = rows_gamma*r.thread_id/r.n_threads;
+  const long row1 = rows_gamma*(r.thread_id + 1)/r.n_threads;
+  if(obj3.size() > 0){
+#pragma omp master
+    {
+      Global.general_gamma = Eigen::Array<T, -1, -1>::Zero(1, size_gamma3*obj3.size());
+      Global.smaller_gamma = Eigen::Array<T, -1, -1>::Zero(rows_gamma, r.n_threads);
+    }
+#pragma omp barrier
+  }
+
+  // finished initializations
+
+
+  // start the kpm iteration
+  long average = 0;
+  progress_start(name_datasets.at(0), long(NDisorder)*NRandomV);
+  for(int disorder = 0; disorder < NDisorder; disorder++){
+    h.generate_disorder();
+    for(unsigned s = 0; s < slots.size(); s++)
+      h.build_velocity(slots.at(s), s);
+    for(int randV = 0; randV < NRandomV; randV++){
+
+      kpm0.initiate_vector();			// original random vector. This sets the index to zero
+      probe_vector(&kpm0);
+      kpm0.Exchange_Boundaries();
+      for(unsigned l = 0; l < chain_slot.size(); l++){
+        kpm_Vn.at(l)->set_index(0);
+        velocity_or_copy(kpm_Vn.at(l), &kpm0, slots, chain_slot.at(l));
+      }
+      for(unsigned k = 0; k < obj1.size(); k++){
+        kpm_VnV.set_index(0);
+        velocity_or_copy(&kpm_VnV, &kpm0, slots, slot.at(obj1.at(k)).at(0));
+        gather_interior(&kpm_VnV, left2, col.at(obj1.at(k)));
+      }
+
+      // run through the left loop NB iterations at a time
+      for(int n = 0; n < N; n+=NB){
+        const int nb = std::min(NB, N - n);
+
+        for(int i = n; i < n + nb; i++){
+          for(unsigned l = 0; l < chain_slot.size(); l++)
+            if(i!=0)
+              cheb_iteration(kpm_Vn.at(l), i-1);
+
+          for(unsigned q = 0; q < objects.size(); q++){
+            if(objects.at(q).size() < 2)
+              continue;
+            kpm_VnV.set_index(0);
+            velocity_or_copy(&kpm_VnV, kpm_Vn.at(chain.at(q)), slots, slot.at(q).at(1));
+            if(objects.at(q).size() == 2)
+              gather_interior(&kpm_VnV, left2, col.at(q) + i - n);
+            else
+              gather_interior(&kpm_VnV, left3.at(group.at(q)), col.at(q) + i - n);
+          }
+        }
+
+        // The right vectors Tp|r> are iterated one at a time. The three-index objects
+        // use each one of them, the others use blocks of MEMORY of them
+        kpm_p.set_index(0);
+        kpm_p.v.col(0) = kpm0.v.col(0);
+        for(int p = 0; p < N; p++){
+          if(p!=0) cheb_iteration(&kpm_p, p-1);
+
+          if(obj3.size() > 0){
+            for(unsigned g = 0; g < group_slot.size(); g++){
+              kpm_pVm.at(g)->set_index(0);
+              velocity_or_copy(kpm_pVm.at(g), &kpm_p, slots, group_slot.at(g));
+              for(int m = 0; m < N; m += MEMORY){
+                for(int mi = m; mi < m + MEMORY; mi++)
+                  if(mi != 0) cheb_iteration(kpm_pVm.at(g), mi-1);
+
+                contract(left3.at(g), kpm_pVm.at(g), tmp);
+                for(unsigned k = 0; k < obj3.size(); k++){
+                  int q = obj3.at(k);
+                  if(group.at(q) != int(g))
+                    continue;
+                  Eigen::Map<Eigen::Array<T, -1, -1>> partial_gamma(Global.smaller_gamma.col(r.thread_id).data() + k*NB*N, NB, N);
+                  partial_gamma.block(0, m, NB, MEMORY) = tmp.block(col.at(q), 0, NB, MEMORY).array();
+                }
+              }
+            }
+
+            // Sum the partial blocks of all the threads and update the average
+#pragma omp barrier
+            for(long k = row0; k < row1; k++){
+              long kk = k%(long(NB)*N);
+              if(kk%NB >= nb)
+                continue;
+              long int index = (k/(long(NB)*N))*size_gamma3 + p*N*N + (kk/NB)*N + n + kk%NB;
+              T sum = Global.smaller_gamma.row(k).sum();
+              Global.general_gamma(index) += (sum - Global.general_gamma(index))/value_type(average + 1);
+            }
+#pragma omp barrier
+          }
+
+          if(p%MEMORY != MEMORY - 1 || left2.cols() == 0)
+            continue;
+
+          // One product for all the one and two-index objects
+          const int m = p - MEMORY + 1;
+          contract(left2, &kpm_p, tmp);
+          long int ind;
+          for(unsigned k = 0; k < obj2.size(); k++){
+            int q = obj2.at(k);
+            for(int j = 0; j < MEMORY; j++)
+              for(int i = 0; i < nb; i++){
+                ind = (m+j)*N + n+i;
+                gamma.at(q)(ind) += (tmp(col.at(q) + i, j) - gamma.at(q)(ind))/value_type(average + 1);
+              }
+          }
+          // <V^a r|Tm|r>^* = <r|Tm V^a|r>, which is what Gamma1D calculates
+          if(n == 0)
+            for(unsigned k = 0; k < obj1.size(); k++){
+              int q = obj1.at(k);
+              for(int j = 0; j < MEMORY; j++)
+                gamma.at(q)(m+j) += (T(factor.at(q))*myconj(tmp(col.at(q), j)) - gamma.at(q)(m+j))/value_type(average + 1);
+            }
+        }
+      }
+      average++;
+      progress_sample();
+    }
+  }
+  progress_finish();
+
+  for(unsigned l = 0; l < chain_slot.size(); l++)
+    delete kpm_Vn.at(l);
+  for(unsigned g = 0; g < group_slot.size(); g++)
+    delete kpm_pVm.at(g);
+
+  // The three-index objects are stored first, because the others reuse Global.general_gamma
+  for(unsigned k = 0; k < obj3.size(); k++){
+    int q = obj3.at(k);
+#pragma omp master
+    {
+      Eigen::Array<T, -1, -1> gamma3 = Global.general_gamma.block(0, k*size_gamma3, 1, size_gamma3);
+      store_gamma3D(&gamma3, {N, N, N}, objects.at(q), name_datasets.at(q));
+    }
+#pragma omp barrier
+  }
+  for(unsigned q = 0; q < objects.size(); q++){
+    if(objects.at(q).size() == 1)
+      store_gamma1D(&gamma.at(q), name_datasets.at(q));
+    if(objects.at(q).size() == 2){
+      gamma.at(q) = gamma.at(q)*factor.at(q);
+      store_gamma(&gamma.at(q), {N, N}, objects.at(q), name_datasets.at(q));
+    }
+    store_weight(name_datasets.at(q), average);
+  }
+}
+
+
+template void Simulation<float ,1u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<double ,1u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<long double ,1u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<std::complex<float> ,1u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<std::complex<double> ,1u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<std::complex<long double> ,1u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+
+template void Simulation<float ,3u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<double ,3u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<long double ,3u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<std::complex<float> ,3u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<std::complex<double> ,3u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<std::complex<long double> ,3u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+
+template void Simulation<float ,2u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<double ,2u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<long double ,2u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<std::complex<float> ,2u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<std::complex<double> ,2u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+template void Simulation<std::complex<long double> ,2u>::GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
@@ -24,6 +24,9 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 #include <cmath>
 #include <math.h>
 #include <initializer_list>
@@ -40,6 +43,18 @@
 #define TILE 64
 #endif
 
+// GEMM_BLOCK is the number of rows of a KPM vector gathered for each GEMM in the Gamma contractions
+#ifndef GEMM_BLOCK
+#define GEMM_BLOCK 4096
+#endif
+
+// MEMORY_BUDGET is the memory, in MB and summed over all the threads, that GammaGeneral may use to
+// keep Chebyshev vectors instead of recalculating them. It can be changed at run time with the
+// environment variable MEMORY_BUDGET
+#ifndef MEMORY_BUDGET
+#define MEMORY_BUDGET 2048
+#endif
+
 #ifndef DEBUG
 #define DEBUG 0
 #endif
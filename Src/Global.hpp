@@ -22,12 +22,19 @@ struct GLOBAL_VARIABLES {
   Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic> singleshot_cond;
   Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic> general_gamma;
   Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic> smaller_gamma;
+  std::vector<Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic>> shared_gamma; // Gamma2D matrices of all the threads in the low-memory mode
   Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic> avg_x;
   Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic> avg_y;
   Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic> avg_z;
   Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic> avg_ident;
   Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic> avg_results;
   double kpm_iteration_time;
+  Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic> sample; // sum over the threads of the last sample
+  bool stop_sampling;
+  std::vector<Eigen::Array <T, Eigen::Dynamic, Eigen::Dynamic>> checkpoint; // arrays of each thread at the last checkpoint
+  std::vector<std::string> checkpoint_state; // random number generators of each thread at the last checkpoint
+  bool save_checkpoint;
+  int  job; // next job of the team
   
   bool calculate_arpes;
   bool calculate_ldos;
@@ -36,6 +43,7 @@ struct GLOBAL_VARIABLES {
   bool calculate_conddc;
   bool calculate_condopt;
   bool calculate_condopt2;
+  bool calculate_gamma;
   bool calculate_singleshot;
 
   GLOBAL_VARIABLES();
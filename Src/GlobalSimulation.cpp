@@ -10,6 +10,8 @@
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
+#include "Diagnostics.hpp"
 #include "Random.hpp"
 template <typename T, unsigned D>
 class Hamiltonian;
@@ -19,10 +21,21 @@ class KPM_Vector;
 #include "Simulation.hpp"
 #include "SimulationGlobal.hpp"
 #include "Hamiltonian.hpp"
+#include "Merge.hpp"
+#include "Autotune.hpp"
+#include "MemoryPlan.hpp"
+#include <atomic>
+#include <filesystem>
 template <typename T,unsigned D>
-GlobalSimulation<T,D>::GlobalSimulation( char *name ) : rglobal(name){
+GlobalSimulation<T,D>::GlobalSimulation( char *name, bool autotune ) : rglobal(name){
   debug_message("Entered global_simulation\n");
 
+  // Choose the fastest domain decomposition first, which rewrites /Divisions
+  if(autotune){
+    Autotune<T,D>::run(name);
+    rglobal = LatticeStructure<D>(name);
+  }
+
   // rglobal is an instance of Lattice Structure which contains all the information
   // about the periodic part of the lattice and the unit cell. It contains the
   // lattice vectors, the number of threads, the size of the lattice inside each
@@ -34,30 +47,252 @@ GlobalSimulation<T,D>::GlobalSimulation( char *name ) : rglobal(name){
   Global.ghosts.resize( rglobal.get_BorderSize() );
   std::fill(Global.ghosts.begin(), Global.ghosts.end(), 0);
     
-  H5::H5File * file12         = new H5::H5File(name, H5F_ACC_RDONLY);
+  H5::H5File * file12 = Config::open(name);
   get_hdf5<double>(&EnergyScale,  file12, (char *)   "/EnergyScale");
-  file12->close();
-  delete file12;
-  
-  omp_set_num_threads(rglobal.n_threads);
-  debug_message("Starting parallelization\n");
+
+  // Optional: number of teams of threads that run the calculations at the same time, and
+  // number of teams that share the random vectors and disorder realisations of each one
+  int teams = 1, ensemble = 1;
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&teams,  file12, (char *)   "/Teams");
+  } catch(H5::Exception& e) {}
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&ensemble,  file12, (char *)   "/Ensemble");
+  } catch(H5::Exception& e) {}
+
+  // Stop before the threads start if the run does not fit in memory
+  double peak = MemoryPlan::estimate<T,D>(name, rglobal, std::max(teams, ensemble), true);
+  if(peak > MemoryPlan::available()){
+    std::cout << "The run needs about " << peak/1024.0/1024.0 << " MB, more than the "
+              << MemoryPlan::available()/1024.0/1024.0 << " MB available. Try LOW_MEMORY=1, fewer "
+              << "moments or fewer threads, or set MEMORY_LIMIT (MB) if the estimate is too high. Exiting.\n";
+    exit(1);
+  }
+
+  if(ensemble > 1)
+    run_ensemble(name, ensemble);
+  else if(teams > 1)
+    run_teams(name, teams);
+  else {
+    omp_set_num_threads(rglobal.n_threads);
+    diagnostics.resize(rglobal.n_threads);
+    debug_message("Starting parallelization\n");
 #pragma omp parallel default(shared)
-  {
-    Simulation<T,D> simul(name, Global);
+    {
+      Diagnostics::local() = Diagnostics();
+      Simulation<T,D> simul(name, Global);
 
-    simul.calc_conddc();
-    simul.calc_condopt();
-    simul.calc_condopt2();
-    simul.calc_singleshot();
-    simul.calc_DOS();
-    simul.calc_wavepacket();
-    simul.calc_LDOS(); 
-    simul.calc_ARPES(); // fetches parameters from .h5 file and calculates ARPES
+      simul.calc_conddc();
+      simul.calc_condopt();
+      simul.calc_condopt2();
+      simul.calc_gamma();
+      simul.calc_singleshot();
+      simul.calc_DOS();
+      simul.calc_wavepacket();
+      simul.calc_LDOS(); 
+      simul.calc_ARPES(); // fetches parameters from .h5 file and calculates ARPES
 
+      diagnostics.at(omp_get_thread_num()) = Diagnostics::local();
+    }
   }
+  Config::release(name);
+  if(Diagnostics::enabled() && ensemble <= 1)
+    Diagnostics::store(name, diagnostics);
+  if(Diagnostics::tracing() != NULL && ensemble <= 1)
+    Diagnostics::trace(diagnostics, rglobal.n_threads);
   debug_message("Left global_simulation\n");
 }
 
+template <typename T,unsigned D>
+void GlobalSimulation<T,D>::run_teams(char *name, int teams){
+  // Splits the threads into teams, each with the threads of the domain decomposition, its
+  // own GLOBAL_VARIABLES and its own Simulations. The calculations are jobs that the teams
+  // take one at a time as they become free. The LDoS and ARPES, which are independent for
+  // each position and k vector, are split into one job for each team
+  typedef void (Simulation<T,D>::*Calculation)();
+  const std::vector<Calculation> calculations = {
+    &Simulation<T,D>::calc_conddc, &Simulation<T,D>::calc_condopt, &Simulation<T,D>::calc_condopt2,
+    &Simulation<T,D>::calc_gamma, &Simulation<T,D>::calc_singleshot, &Simulation<T,D>::calc_DOS,
+    &Simulation<T,D>::calc_wavepacket, &Simulation<T,D>::calc_LDOS, &Simulation<T,D>::calc_ARPES};
+  const unsigned split = 7; // the calculations from here on are split
+
+  std::vector<std::pair<unsigned, Job>> jobs; // calculation and share of each job
+  for(unsigned c = 0; c < calculations.size(); c++){
+    int parts = (c < split) ? 1 : teams;
+    for(int part = 0; part < parts; part++){
+      Job job;
+      job.teams = teams;
+      job.part = part;
+      job.parts = parts;
+      jobs.push_back(std::make_pair(c, job));
+    }
+  }
+
+  std::cout << "Running the calculations with " << teams << " teams of "
+            << rglobal.n_threads << " threads.\n";
+
+  // The teams open the configuration file at the same time, for reading and for writing.
+  // Keeping it open here makes all those opens share this one
+  H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+
+  std::atomic<int> next(0);
+  diagnostics.resize(teams*rglobal.n_threads);
+  omp_set_max_active_levels(2);
+  debug_message("Starting parallelization\n");
+#pragma omp parallel num_threads(teams) default(shared)
+  {
+    GLOBAL_VARIABLES <T> team_global;
+    team_global.ghosts.resize( rglobal.get_BorderSize() );
+    std::fill(team_global.ghosts.begin(), team_global.ghosts.end(), 0);
+
+#pragma omp parallel num_threads(rglobal.n_threads) default(shared)
+    {
+      Diagnostics::local() = Diagnostics();
+      Simulation<T,D> simul(name, team_global);
+      while(true){
+#pragma omp master
+        team_global.job = next++;
+#pragma omp barrier
+        int index = team_global.job;
+#pragma omp barrier
+        if(index >= int(jobs.size()))
+          break;
+
+        simul.job = jobs.at(index).second;
+        (simul.*calculations.at(jobs.at(index).first))();
+        simul.job = Job();
+      }
+      diagnostics.at(omp_get_ancestor_thread_num(1)*rglobal.n_threads + omp_get_thread_num()) = Diagnostics::local();
+    }
+  }
+
+  file->close();
+  delete file;
+}
+
+template <typename T,unsigned D>
+void GlobalSimulation<T,D>::run_ensemble(char *name, int teams){
+  // Each team runs all the calculations on its own copy of the configuration, with its share
+  // of the disorder realisations, or of the random vectors when there are fewer realisations
+  // than teams. The copies are then merged into the configuration file, as KITEx --merge
+  // does with independent runs. A calculation that cannot be shared is done by the first team
+  std::vector<std::string> names;
+  for(int team = 0; team < teams; team++)
+    names.push_back(std::string(name) + ".team" + std::to_string(team));
+
+  // Shared counts, with their value in the configuration file
+  std::vector<std::pair<std::string, int>> shared;
+  {
+    H5::H5File * file = Config::open(name);
+    if(H5Lexists(file->getId(), "/Calculation", H5P_DEFAULT) > 0){
+      H5::Group calculation = file->openGroup("/Calculation");
+      for(hsize_t i = 0; i < calculation.getNumObjs(); i++){
+        std::string group = "/Calculation/" + calculation.getObjnameByIdx(i) + "/";
+        auto count = [&](std::string dataset){
+          int value = 0;
+          try{
+            H5::Exception::dontPrint();
+            if(file->openDataSet(group + dataset).getSpace().getSimpleExtentNpoints() == 1)
+              get_hdf5<int>(&value, file, (char *) (group + dataset).c_str());
+          } catch(H5::Exception& e) {}
+          return value;
+        };
+
+        // The single shot and the wave packet are not averages with a weight, and the kept
+        // recursions belong to one run
+        if(group == "/Calculation/singleshot_conductivity_dc/" || group == "/Calculation/gaussian_wave_packet/" ||
+           count("SaveVectors") || count("Extend"))
+          shared.push_back(std::make_pair(group, 0));
+        else if(count("NumDisorder") >= teams)
+          shared.push_back(std::make_pair(group + "NumDisorder", count("NumDisorder")));
+        else if(count("NumRandoms") >= teams)
+          shared.push_back(std::make_pair(group + "NumRandoms", count("NumRandoms")));
+        else
+          shared.push_back(std::make_pair(group, 0));
+      }
+    }
+  }
+
+  for(int team = 0; team < teams; team++){
+    std::filesystem::copy_file(name, names.at(team), std::filesystem::copy_options::overwrite_existing);
+    H5::H5File * file = new H5::H5File(names.at(team), H5F_ACC_RDWR);
+    for(auto & count : shared){
+      if(count.second == 0){
+        if(team > 0)
+          file->unlink(count.first.substr(0, count.first.size() - 1));
+        continue;
+      }
+      int share = count.second*(team + 1)/teams - count.second*team/teams;
+      file->openDataSet(count.first).write(&share, H5::PredType::NATIVE_INT);
+    }
+    file->close();
+    delete file;
+  }
+
+  std::cout << "Running the calculations with an ensemble of " << teams << " teams of "
+            << rglobal.n_threads << " threads.\n";
+
+  diagnostics.resize(teams*rglobal.n_threads);
+  omp_set_max_active_levels(2);
+  debug_message("Starting parallelization\n");
+#pragma omp parallel num_threads(teams) default(shared)
+  {
+    const int team = omp_get_thread_num();
+    GLOBAL_VARIABLES <T> team_global;
+    team_global.ghosts.resize( rglobal.get_BorderSize() );
+    std::fill(team_global.ghosts.begin(), team_global.ghosts.end(), 0);
+
+#pragma omp parallel num_threads(rglobal.n_threads) default(shared)
+    {
+      Diagnostics::local() = Diagnostics();
+      Simulation<T,D> simul(&names.at(team)[0], team_global);
+      simul.job.teams = teams;
+
+      // With a fixed SEED all the teams would draw the same numbers. The first team keeps
+      // it, so its samples are those of a run without teams
+      char * env = getenv("SEED");
+      if(env != NULL && team > 0){
+        simul.rnd.seed(atoi(env) + team);
+        simul.h.rnd.seed(atoi(env) + team);
+      }
+
+      simul.calc_conddc();
+      simul.calc_condopt();
+      simul.calc_condopt2();
+      simul.calc_gamma();
+      simul.calc_singleshot();
+      simul.calc_DOS();
+      simul.calc_wavepacket();
+      simul.calc_LDOS();
+      simul.calc_ARPES();
+      diagnostics.at(team*rglobal.n_threads + omp_get_thread_num()) = Diagnostics::local();
+    }
+  }
+
+  for(auto & team_name : names)
+    Config::release(team_name);
+  if(merge_outputs(names, name) != 0){
+    std::cout << "The outputs of the teams are kept in " << name << ".team*. Exiting.\n";
+    exit(1);
+  }
+
+  // The merged file is a copy of the first one, with its share of the counts
+  H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+  for(auto & count : shared)
+    if(count.second > 0)
+      file->openDataSet(count.first).write(&count.second, H5::PredType::NATIVE_INT);
+  file->close();
+  delete file;
+  for(auto & team_name : names)
+    std::filesystem::remove(team_name);
+  if(Diagnostics::enabled())
+    Diagnostics::store(name, diagnostics);
+  if(Diagnostics::tracing() != NULL)
+    Diagnostics::trace(diagnostics, rglobal.n_threads);
+}
+
 template class GlobalSimulation<float ,1u>;
 template class GlobalSimulation<double ,1u>;
 template class GlobalSimulation<long double ,1u>;
@@ -13,6 +13,8 @@
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
+#include "Diagnostics.hpp"
 #include "Global.hpp"
 #include "Hamiltonian.hpp"
 
@@ -30,6 +32,7 @@ Hamiltonian<T,D>::Hamiltonian(char *filename,  LatticeStructure<D> & rr, GLOBAL_
 template <typename T, unsigned D>
 void Hamiltonian<T,D>::generate_disorder()
 {
+  ScopedTimer timer(Diagnostics::DISORDER);
   distribute_AndersonDisorder();
   for(std::size_t istr = 0; istr < r.NStr; istr++)
     cross_mozaic[istr] = true;
@@ -50,7 +53,7 @@ void Hamiltonian<T,D>::build_structural_disorder()
   
 #pragma omp critical
   {
-    H5::H5File *file = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
     // Test if there is a strutural disorder to build
     H5::Group  grp;
     std::vector<std::string> defects;
@@ -65,7 +68,6 @@ void Hamiltonian<T,D>::build_structural_disorder()
     catch(H5::Exception& e) {
       // Do nothing
     };
-    delete file;
   }
 }
 
@@ -76,7 +78,7 @@ void Hamiltonian<T,D>::build_vacancies_disorder()
   r.SizetVacancies = 0;
 #pragma omp critical
   {
-    H5::H5File *file = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
     // Test if there is vacancies to build
     H5::Group  grp;
     std::vector<int> tmp;
@@ -127,7 +129,6 @@ void Hamiltonian<T,D>::build_vacancies_disorder()
     catch(H5::Exception& e) {
       // Do nothing
     }
-    delete file;
   }
   
 }
@@ -143,7 +144,7 @@ void Hamiltonian<T,D>::build_Anderson_disorder() {
 #pragma omp critical
   {
 
-    H5::H5File    *file      = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
     try {
       H5::DataSet   dataset    = H5::DataSet(file->openDataSet("/Hamiltonian/Disorder/OrbitalNum"));
       H5::DataSpace dataspace  = dataset.getSpace();
@@ -161,7 +162,6 @@ void Hamiltonian<T,D>::build_Anderson_disorder() {
 
     }
     catch (...){}
-    delete file;
   }
     
   Anderson_orb_address.resize(r.Orb);
@@ -205,6 +205,7 @@ void Hamiltonian<T,D>::build_Anderson_disorder() {
 template <typename T, unsigned D>
 void Hamiltonian<T,D>::build_velocity(std::vector<unsigned> & components, unsigned n)
 {
+  ScopedTimer timer(Diagnostics::VELOCITY);
   hr.build_velocity(components, n);
   for(auto i = hd.begin(); i != hd.end(); i++)
     i->build_velocity(components, n);
@@ -11,6 +11,7 @@
 #include "ComplexTraits.hpp"
 #include "Random.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
 #include "HamiltonianRegular.hpp"
@@ -24,7 +25,7 @@ Periodic_Operator<T,D>::Periodic_Operator (char * name, LatticeStructure<D> & rr
   NHoppings =  Eigen::Array<unsigned, Eigen::Dynamic, 1 > (r.Orb);
 #pragma omp critical
   {
-    H5::H5File *file = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
     get_hdf5<unsigned>(NHoppings.data(), file, (char *) "/Hamiltonian/NHoppings");
     
     std::size_t max  	= NHoppings.maxCoeff();
@@ -38,7 +39,6 @@ Periodic_Operator<T,D>::Periodic_Operator (char * name, LatticeStructure<D> & rr
     for(std::size_t i = 0; i < max; i++ )
       for(std::size_t j = 0; j <  r.Orb; j++ )      
         distance(i,j) = dist(i,j);
-    delete file;
     Convert_Build(r);
   }
   debug_message("Left Periodic_Operator constructor.\n");
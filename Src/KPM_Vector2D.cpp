@@ -12,6 +12,7 @@
 #include <random>
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Diagnostics.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
@@ -540,11 +541,15 @@ void KPM_Vector <T, 2>::measure_wave_packet(T * bra, T * ket, T * results)
 }
 template <typename T>
 void KPM_Vector <T, 2>::Exchange_Boundaries() {
+  ScopedTimer timer(Diagnostics::EXCHANGE);
   /*
     I have four boundaries to exchange with the other threads.
     First I will copy the lines along the a[1] direction to a consecutive shared vector
   */
-#pragma omp barrier    
+  {
+    ScopedTimer wait(Diagnostics::BARRIER);
+#pragma omp barrier
+  }
   Coordinates<std::size_t,3u> x(r.Ld), z(r.Lt);
   T  *phi = v.col(index).data();
 
@@ -577,13 +582,19 @@ void KPM_Vector <T, 2>::Exchange_Boundaries() {
 	
       // Copy the boundaries to the shared memory
       std::copy( ghosts_left, ghosts_left + 2*BSize, simul.Global.ghosts.begin() + 2*BSize * r.thread_id );	  
+      {
+        ScopedTimer wait(Diagnostics::BARRIER);
 #pragma omp barrier
+      }
       auto neigh_left = simul.Global.ghosts.begin() + 2 * block[d][0] * BSize;
       auto neigh_right  = simul.Global.ghosts.begin() + 2 * block[d][1] * BSize;
       std::copy(neigh_right,         neigh_right + BSize , ghosts_right );     // From the left to the right
       std::copy(neigh_left + BSize,  neigh_left + 2*BSize, ghosts_left  )  ;   // From the right to the left
 	
-#pragma omp barrier	
+      {
+        ScopedTimer wait(Diagnostics::BARRIER);
+#pragma omp barrier
+      }
       for(std::size_t io = 0; io < r.Orb; io++)
         {
           std::size_t il = MemIndEnd[d][0][io];
@@ -11,6 +11,7 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
 
@@ -20,7 +21,7 @@ LatticeStructure<D>::LatticeStructure(char *name )
   
 #pragma omp critical
   {
-    H5::H5File *file = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
     get_hdf5<unsigned>(&Orb, file, (char *) "/NOrbitals");
     get_hdf5<double>(rLat.data(), file, (char *) "/LattVectors");    
     rOrb = Eigen::MatrixXd::Zero(D, Orb);
@@ -36,7 +37,6 @@ LatticeStructure<D>::LatticeStructure(char *name )
       get_hdf5<int>(&MagneticField, file, (char *) "/Hamiltonian/MagneticFieldMul");
     }
     catch (H5::Exception& e){}
-    file->close();
   }
 
   // Set the ghost_correlation potential and normalize it to the size of the system
@@ -76,6 +76,20 @@ LatticeStructure<D>::LatticeStructure(char *name )
   Sizet = Nt * Orb;
   SizetVacancies = 0;
   thread_id = omp_get_thread_num();
+
+  // The sites of the sub-domain that are not ghosts form Size/ld[0] contiguous lines
+  // of ld[0] elements. Store where each line starts so the ghosts can be skipped
+  // when contracting vectors
+  Coordinates<std::size_t, D + 1> xl(ld), xL(Ld);
+  lines.resize(Size/ld[0]);
+  for(std::size_t l = 0; l < lines.size(); l++)
+    {
+      xl.set_coord(l * ld[0]);
+      for(unsigned i = 0; i < D; i++)
+        xL.coord[i] = xl.coord[i] + NGHOSTS;
+      xL.coord[D] = xl.coord[D];
+      lines[l] = xL.set_index(xL.coord).index;
+    }
     
   Coordinates<unsigned, D + 1> dist(nd);
   dist.set_coord(unsigned(thread_id));
@@ -31,6 +31,7 @@ public:
   std::size_t Nd; // Number of lattice postions of the sub-domain with ghosts
   std::size_t N; // Number of lattice postions of the sub-domain without ghosts
   std::size_t NStr; // Number of lattice postions of the sub-domain without ghosts
+  std::vector<std::size_t> lines; // Start of each line of ld[0] sites of the sub-domain (with ghosts indexing)
   unsigned Orb; // Number of orbitals
   unsigned thread_id; // thread identification
   int MagneticField = 0;
@@ -0,0 +1,209 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Config.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+#include "MemoryPlan.hpp"
+#include <iomanip>
+#include <unistd.h>
+
+namespace {
+bool found(H5::H5File * file, const std::string & path){
+  H5::Exception::dontPrint();
+  return H5Lexists(file->getId(), path.c_str(), H5P_DEFAULT) > 0;
+}
+
+long points(H5::H5File * file, const std::string & path){
+  // Entries of a dataset, or 0 if there is none
+  if(!found(file, path))
+    return 0;
+  return file->openDataSet(path).getSpace().getSimpleExtentNpoints();
+}
+
+template <typename U>
+U first(H5::H5File * file, const std::string & path, U value){
+  // First entry of a dataset, or value if there is none
+  long n = points(file, path);
+  if(n == 0)
+    return value;
+  std::vector<U> all(n);
+  get_hdf5<U>(all.data(), file, (char *) path.c_str());
+  return all.at(0);
+}
+
+std::vector<std::string> groups(H5::H5File * file, const std::string & path){
+  std::vector<std::string> names;
+  if(!found(file, path))
+    return names;
+  H5::Group group = file->openGroup(path);
+  for(hsize_t i = 0; i < group.getNumObjs(); i++)
+    names.push_back(path + "/" + group.getObjnameByIdx(i));
+  return names;
+}
+}
+
+double MemoryPlan::available(){
+  char *env = getenv("MEMORY_LIMIT");
+  if(env != NULL && atof(env) > 0)
+    return atof(env)*1024.0*1024.0;
+  return double(sysconf(_SC_PHYS_PAGES))*sysconf(_SC_PAGESIZE);
+}
+
+template <typename T, unsigned D>
+double MemoryPlan::estimate(char *name, LatticeStructure<D> & r, int teams, bool print){
+  // Peak memory of the run in bytes, for teams teams of r.n_threads threads
+  typedef typename extract_value_type<T>::value_type value_type;
+  H5::H5File * file = Config::open(name);
+  const std::string calc = "/Calculation/";
+  const double s = sizeof(T), n = r.n_threads;
+  const double vector = r.Sized*s, interior = r.Size*s;   // one KPM vector with and without ghosts
+  const double B = MemoryPlan::block();
+  const bool shared = MemoryPlan::low_memory();
+  double budget = MEMORY_BUDGET;
+  char *env = getenv("MEMORY_BUDGET");
+  if(env != NULL)
+    budget = atof(env);
+  budget *= 1024.0*1024.0;
+
+  std::vector<std::pair<std::string, double>> parts;
+
+  // Disorder of each thread: the Anderson energies of each model with ghosts, and the lists of
+  // vacancies and defects. And the ghosts exchanged by the threads
+  double hamiltonian = r.get_BorderSize()*s;
+  long n_orbitals = points(file, "/Hamiltonian/Disorder/OrbitalNum");
+  if(n_orbitals > 0){
+    std::vector<int> model(points(file, "/Hamiltonian/Disorder/OnsiteDisorderModelType"));
+    if(model.size() > 0)
+      get_hdf5<int>(model.data(), file, (char *) "/Hamiltonian/Disorder/OnsiteDisorderModelType");
+    for(auto m : model)
+      if(m < 3)
+        hamiltonian += n*r.Nd*sizeof(value_type);
+  }
+  for(auto & type : groups(file, "/Hamiltonian/Vacancy"))
+    hamiltonian += n*first<double>(file, type + "/Concentration", 0)*r.N
+      *first<int>(file, type + "/NumOrbitals", 1)*sizeof(std::size_t);
+  for(auto & type : groups(file, "/Hamiltonian/StructuralDisorder"))
+    hamiltonian += n*first<double>(file, type + "/Concentration", 0)*r.N
+      *(first<int>(file, type + "/NumNodes", 1)*(sizeof(std::size_t) + s)
+        + first<int>(file, type + "/NumBondDisorder", 0)*(2*sizeof(std::size_t) + 2*s));
+  parts.push_back(std::make_pair("Hamiltonian and ghosts", hamiltonian));
+
+  // Gamma2D: the Gamma matrices of each thread and their sum in store_gamma or, in the
+  // low-memory mode, the matrices shared by the threads
+  auto gamma2D = [&](double N, double components, double vectors, double gathered){
+    double matrices = shared ? components : n*components + 1;
+    return n*(vectors*vector + gathered*interior) + matrices*N*N*s;
+  };
+
+  double N;
+  if(found(file, calc + "dos/NumMoments")){
+    N = first<int>(file, calc + "dos/NumMoments", 0);
+    double orbitals = first<int>(file, calc + "dos/PDOS", 0) ? r.Orb : 0;
+    parts.push_back(std::make_pair("dos", n*3*vector + (n + 1)*(1 + orbitals)*N*s));
+  }
+
+  if(found(file, calc + "conductivity_dc/NumMoments")){
+    N = first<int>(file, calc + "conductivity_dc/NumMoments", 0);
+    double C = std::max(1L, points(file, calc + "conductivity_dc/Directions"));
+    double dos = first<int>(file, calc + "conductivity_dc/HarvestDOS", 0);
+    parts.push_back(std::make_pair("conductivity_dc", gamma2D(N, C, 2*C + B + 2, C*B + dos)));
+  }
+
+  if(found(file, calc + "conductivity_optical/NumMoments")){
+    N = first<int>(file, calc + "conductivity_optical/NumMoments", 0);
+    if(first<int>(file, calc + "conductivity_optical/Fused", 0))
+      parts.push_back(std::make_pair("conductivity_optical",
+                                     n*(2*MEMORY + 6)*vector + std::min(budget, 2*N*n*interior) + (n + 1)*N*N*s));
+    else
+      parts.push_back(std::make_pair("conductivity_optical", gamma2D(N, 1, B + 4, B)));
+  }
+
+  if(found(file, calc + "conductivity_optical_nonlinear/NumMoments")){
+    N = first<int>(file, calc + "conductivity_optical_nonlinear/NumMoments", 0);
+    double peak = gamma2D(N, 1, B + 4, B);
+    if(first<int>(file, calc + "conductivity_optical_nonlinear/Special", 0) != 1)
+      // Gamma3D: the shared matrix, its symmetrised copy and the partial blocks of the threads
+      peak = std::max(peak, n*(MEMORY + 6)*vector + (2*N*N*N + MEMORY*N*n)*s
+                      + (first<int>(file, calc + "conductivity_optical_nonlinear/Fused", 0) ? std::min(budget, 2*N*n*interior) : 0));
+    parts.push_back(std::make_pair("conductivity_optical_nonlinear", peak));
+  }
+
+  if(found(file, calc + "gamma/NumMoments")){
+    std::vector<int> moments(points(file, calc + "gamma/NumMoments"));
+    get_hdf5<int>(moments.data(), file, (char *) (calc + "gamma/NumMoments").c_str());
+    double size = 1;
+    for(auto m : moments)
+      size *= m;
+    double last = moments.back();
+    parts.push_back(std::make_pair("gamma", n*(2*moments.size() + MEMORY + 4)*vector + n*MEMORY*interior
+                                   + std::min(budget, last*n*interior) + (size + MEMORY*last*n)*s));
+  }
+
+  if(found(file, calc + "singleshot_conductivity_dc/NumMoments"))
+    parts.push_back(std::make_pair("singleshot_conductivity_dc", n*3*vector));
+
+  if(found(file, calc + "gaussian_wave_packet/NumMoments"))
+    parts.push_back(std::make_pair("gaussian_wave_packet", n*3*vector));
+
+  if(found(file, calc + "ldos/NumMoments")){
+    N = first<unsigned>(file, calc + "ldos/NumMoments", 0);
+    double P = points(file, calc + "ldos/Orbitals");
+    parts.push_back(std::make_pair("ldos", n*(3*vector + interior) + (n + 1)*N*P*s));
+  }
+
+  if(found(file, calc + "arpes/NumMoments")){
+    N = first<int>(file, calc + "arpes/NumMoments", 0);
+    double K = points(file, calc + "arpes/k_vector")/double(D);
+    parts.push_back(std::make_pair("arpes", n*(3*vector + interior) + (n + 1)*N*K*s));
+  }
+
+  double largest = 0;
+  for(unsigned i = 1; i < parts.size(); i++)
+    largest = std::max(largest, parts.at(i).second);
+  double peak = teams*(hamiltonian + largest);
+
+  if(print){
+    const double MB = 1024.0*1024.0;
+    std::cout << "Memory plan (MB, " << teams << (teams > 1 ? " teams" : " team") << " of "
+              << r.n_threads << " threads" << (shared ? ", low-memory mode" : "") << "):\n";
+    for(auto & part : parts)
+      std::cout << "  " << std::left << std::setw(32) << part.first << std::right << std::fixed
+                << std::setprecision(1) << std::setw(12) << part.second/MB << "\n";
+    std::cout << "  " << std::left << std::setw(32) << "Peak" << std::right << std::setw(12) << peak/MB
+              << " of " << available()/MB << " available\n";
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+  }
+  return peak;
+}
+
+template double MemoryPlan::estimate<float ,1u>(char *, LatticeStructure<1u> &, int, bool);
+template double MemoryPlan::estimate<double ,1u>(char *, LatticeStructure<1u> &, int, bool);
+template double MemoryPlan::estimate<long double ,1u>(char *, LatticeStructure<1u> &, int, bool);
+template double MemoryPlan::estimate<std::complex<float> ,1u>(char *, LatticeStructure<1u> &, int, bool);
+template double MemoryPlan::estimate<std::complex<double> ,1u>(char *, LatticeStructure<1u> &, int, bool);
+template double MemoryPlan::estimate<std::complex<long double> ,1u>(char *, LatticeStructure<1u> &, int, bool);
+
+template double MemoryPlan::estimate<float ,2u>(char *, LatticeStructure<2u> &, int, bool);
+template double MemoryPlan::estimate<double ,2u>(char *, LatticeStructure<2u> &, int, bool);
+template double MemoryPlan::estimate<long double ,2u>(char *, LatticeStructure<2u> &, int, bool);
+template double MemoryPlan::estimate<std::complex<float> ,2u>(char *, LatticeStructure<2u> &, int, bool);
+template double MemoryPlan::estimate<std::complex<double> ,2u>(char *, LatticeStructure<2u> &, int, bool);
+template double MemoryPlan::estimate<std::complex<long double> ,2u>(char *, LatticeStructure<2u> &, int, bool);
+
+template double MemoryPlan::estimate<float ,3u>(char *, LatticeStructure<3u> &, int, bool);
+template double MemoryPlan::estimate<double ,3u>(char *, LatticeStructure<3u> &, int, bool);
+template double MemoryPlan::estimate<long double ,3u>(char *, LatticeStructure<3u> &, int, bool);
+template double MemoryPlan::estimate<std::complex<float> ,3u>(char *, LatticeStructure<3u> &, int, bool);
+template double MemoryPlan::estimate<std::complex<double> ,3u>(char *, LatticeStructure<3u> &, int, bool);
+template double MemoryPlan::estimate<std::complex<long double> ,3u>(char *, LatticeStructure<3u> &, int, bool);
@@ -0,0 +1,33 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+// Pre-flight memory planner. Before the threads start, estimate adds up the large allocations
+// of each requested calculation: its KPM vectors, the Gamma matrices of the threads and the
+// shared ones, plus the disorder of the Hamiltonian and the ghosts. The calculations run one
+// after the other, so the peak is the largest of them; the teams run at the same time. The run
+// stops if the peak is more than MEMORY_LIMIT MB, by default the memory of the machine.
+//
+// With LOW_MEMORY=1, Gamma2D keeps LOW_MEMORY_BLOCK vectors (4 by default) in each block instead
+// of MEMORY, and the threads add their moments to a single Gamma matrix instead of keeping one
+// each. The checkpoints and the stopping rules need the matrices of each thread, and turn it off
+class MemoryPlan {
+public:
+  static bool low_memory(){
+    static const bool on = getenv("LOW_MEMORY") != NULL && atoi(getenv("LOW_MEMORY")) != 0;
+    return on;
+  }
+  static int block(){                            // vectors in each block of Gamma2D
+    static const int size = getenv("LOW_MEMORY_BLOCK") != NULL && atoi(getenv("LOW_MEMORY_BLOCK")) > 0 ?
+      std::min(atoi(getenv("LOW_MEMORY_BLOCK")), int(MEMORY)) : std::min(4, int(MEMORY));
+    return low_memory() ? size : MEMORY;
+  }
+  static double available();                     // in bytes
+  template <typename T, unsigned D>
+  static double estimate(char *, LatticeStructure<D> &, int, bool);
+};
@@ -0,0 +1,206 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Merge.hpp"
+#include <filesystem>
+#include <set>
+
+namespace {
+
+const hsize_t BLOCK = 1 << 20;  // number of elements merged at once
+
+enum Combine { AVERAGE, ERROR, SUM };
+
+herr_t collect_link(hid_t, const char * link, const H5L_info_t *, void * names){
+  static_cast<std::vector<std::string>*>(names)->push_back(link);
+  return 0;
+}
+
+bool ends_with(const std::string & s, const std::string & end){
+  return s.size() >= end.size() && s.compare(s.size() - end.size(), end.size(), end) == 0;
+}
+
+bool exists(H5::H5File & file, const std::string & path){
+  return H5Lexists(file.getId(), path.c_str(), H5P_DEFAULT) > 0;
+}
+
+std::vector<hsize_t> extent(H5::DataSet & dataset){
+  H5::DataSpace space = dataset.getSpace();
+  std::vector<hsize_t> dims(space.getSimpleExtentNdims());
+  space.getSimpleExtentDims(dims.data(), NULL);
+  return dims;
+}
+
+template <typename U>
+void combine(std::vector<H5::DataSet> & datasets, H5::DataSet & merged, std::vector<hsize_t> dims,
+             const H5::DataType & datatype, const std::vector<long double> & weights, Combine mode){
+  // Streams the dataset of all the inputs through the output, one block of rows at a time
+  long double total = 0;
+  for(long double w : weights)
+    total += w;
+
+  hsize_t width = 1;
+  for(unsigned d = 1; d < dims.size(); d++)
+    width *= dims.at(d);
+  const hsize_t rows = std::max<hsize_t>(1, BLOCK/width);
+
+  for(hsize_t row0 = 0; row0 < dims.at(0); row0 += rows){
+    std::vector<hsize_t> offset(dims.size(), 0), count(dims);
+    offset.at(0) = row0;
+    count.at(0) = std::min(rows, dims.at(0) - row0);
+    hsize_t size = count.at(0)*width;
+    H5::DataSpace memspace(1, &size);
+
+    Eigen::Array<U, -1, 1> sum = Eigen::Array<U, -1, 1>::Zero(size);
+    Eigen::Array<U, -1, 1> block(size);
+    for(unsigned i = 0; i < datasets.size(); i++){
+      H5::DataSpace space = datasets.at(i).getSpace();
+      space.selectHyperslab(H5S_SELECT_SET, count.data(), offset.data());
+      datasets.at(i).read(block.data(), datatype, memspace, space);
+      if(mode == AVERAGE)
+        sum += weights.at(i)*block;
+      if(mode == ERROR)
+        sum += (weights.at(i)*weights.at(i)*block.abs2()).template cast<U>();
+      if(mode == SUM)
+        sum += block;
+    }
+    if(mode == AVERAGE)
+      sum /= U(total);
+    if(mode == ERROR)
+      sum = (sum.real().sqrt()/total).template cast<U>();
+
+    H5::DataSpace space = merged.getSpace();
+    space.selectHyperslab(H5S_SELECT_SET, count.data(), offset.data());
+    merged.write(sum.data(), datatype, memspace, space);
+  }
+}
+
+void combine(std::vector<H5::H5File*> & inputs, H5::H5File & output, const std::string & path,
+             const std::vector<long double> & weights, Combine mode){
+  // The complex datasets are combined as complex<long double> and the others as long double.
+  // HDF5 converts them from and to the precision of the file
+  std::vector<H5::DataSet> datasets;
+  for(auto input : inputs)
+    datasets.push_back(input->openDataSet(path));
+  H5::DataSet merged = output.openDataSet(path);
+  std::vector<hsize_t> dims = extent(merged);
+  for(auto & dataset : datasets)
+    if(extent(dataset) != dims || dataset.getTypeClass() != merged.getTypeClass())
+      throw std::runtime_error(path + " is not the same in all the files");
+  if(dims.empty())
+    throw std::runtime_error(path + " is not an array");
+
+  if(merged.getTypeClass() == H5T_COMPOUND){
+    H5::CompType complex_datatype(sizeof(std::complex<long double>));
+    complex_datatype.insertMember("r", 0, H5::PredType::NATIVE_LDOUBLE);
+    complex_datatype.insertMember("i", sizeof(long double), H5::PredType::NATIVE_LDOUBLE);
+    combine<std::complex<long double>>(datasets, merged, dims, complex_datatype, weights, mode);
+  } else
+    combine<long double>(datasets, merged, dims, H5::PredType::NATIVE_LDOUBLE, weights, mode);
+}
+
+}
+
+
+int merge_outputs(std::vector<std::string> inputs, std::string output){
+  if(inputs.size() < 2){
+    std::cout << "--merge needs at least two files. Exiting.\n";
+    return 1;
+  }
+  H5::Exception::dontPrint();
+  try{
+    // The output starts as a copy of the first input, so everything that is not an average
+    // (the configuration, the Hamiltonian) comes from it
+    std::filesystem::copy_file(inputs.at(0), output, std::filesystem::copy_options::overwrite_existing);
+
+    std::vector<H5::H5File*> files;
+    for(auto & input : inputs)
+      files.push_back(new H5::H5File(input, H5F_ACC_RDONLY));
+    H5::H5File merged(output, H5F_ACC_RDWR);
+
+    std::vector<std::string> names;
+    if(exists(merged, "/Calculation"))
+      H5Lvisit(merged.openGroup("/Calculation").getId(), H5_INDEX_NAME, H5_ITER_INC, collect_link, &names);
+
+    int count = 0;
+    std::vector<std::pair<std::string, std::string>> discarded; // and the dataset they describe
+    std::set<std::string> bases;
+    for(auto & name : names){
+      std::string path = "/Calculation/" + name;
+      for(std::string end : {"PerSample", "Resume"})
+        if(ends_with(path, end))
+          discarded.push_back(std::make_pair(path, path.substr(0, path.size() - end.size())));
+      if(!ends_with(path, "Weight"))
+        continue;
+      std::string base = path.substr(0, path.size() - std::string("Weight").size());
+
+      std::vector<long double> weights;
+      bool everywhere = exists(merged, base);
+      for(auto file : files){
+        everywhere = everywhere && exists(*file, path) && exists(*file, base);
+        if(!everywhere)
+          break;
+        int weight = 0;
+        get_hdf5<int>(&weight, file, (char *) path.c_str());
+        weights.push_back(weight);
+      }
+      if(!everywhere){
+        std::cout << "Skipping " << base << ", which is not in all the files.\n";
+        continue;
+      }
+
+      long total = 0;
+      for(long double w : weights)
+        total += long(w);
+      if(total == 0){
+        std::cout << "Skipping " << base << ", which has no samples.\n";
+        continue;
+      }
+      combine(files, merged, base, weights, AVERAGE);
+      Eigen::Array<int, -1, -1> value = Eigen::Array<int, -1, -1>::Constant(1, 1, total);
+      write_hdf5(value, &merged, path);
+
+      // The standard errors of the sampling, when all the runs have them
+      bool sampled = true;
+      for(auto file : files)
+        sampled = sampled && exists(*file, base + "Error") && exists(*file, base + "Samples");
+      if(sampled){
+        combine(files, merged, base + "Error", weights, ERROR);
+        combine(files, merged, base + "Samples", weights, SUM);
+      } else
+        for(std::string stat : {"Error", "Samples"})
+          if(exists(merged, base + stat))
+            merged.unlink(base + stat);
+      std::cout << "Merged " << base << " with " << total << " samples.\n";
+      bases.insert(base);
+      count++;
+    }
+
+    // The samples and the kept recursions of the merged datasets only describe the first run
+    for(auto & path : discarded)
+      if(bases.count(path.second) && exists(merged, path.first)){
+        merged.unlink(path.first);
+        std::cout << "Removed " << path.first << ", which cannot be merged.\n";
+      }
+
+    for(auto file : files)
+      delete file;
+    std::cout << "Merged " << count << " datasets of " << inputs.size() << " files into " << output << ".\n";
+  } catch(std::exception & e) {
+    std::cout << "Cannot merge the files: " << e.what() << ". Exiting.\n";
+    return 1;
+  } catch(H5::Exception & e) {
+    std::cout << "Cannot merge the files: " << e.getDetailMsg() << ". Exiting.\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,14 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+// Combines the outputs of independent runs of the same configuration, as if they were one run
+// with all their samples. Every dataset X stored with its number of samples XWeight becomes
+// the weighted average of the X of the inputs. The datasets are streamed in blocks of rows,
+// so files much larger than the memory can be merged. Returns 0 on success
+int merge_outputs(std::vector<std::string> inputs, std::string output);
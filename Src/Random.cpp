@@ -9,6 +9,7 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "Random.hpp"
+#include <sstream>
 
 template <typename T>
 KPMRandom<T>::KPMRandom() {
@@ -35,6 +36,31 @@ void KPMRandom<T>::init_random()
     }
 }
 
+template <typename T>
+void KPMRandom<T>::seed(unsigned s)
+{
+  // Restarts the sequence from a known seed, so a disorder realisation can be generated again
+  rng.seed(s);
+  dist.reset();
+  gauss.reset();
+}
+
+template <typename T>
+std::string KPMRandom<T>::state()
+{
+  // Whole state of the generator and of the distributions, which may keep a number for the next call
+  std::ostringstream stream;
+  stream << rng << ' ' << dist << ' ' << gauss;
+  return stream.str();
+}
+
+template <typename T>
+void KPMRandom<T>::set_state(const std::string & state)
+{
+  std::istringstream stream(state);
+  stream >> rng >> dist >> gauss;
+}
+
 template <typename T>
 double  KPMRandom<T>::get() {
   return dist(rng);
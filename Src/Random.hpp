@@ -16,6 +16,9 @@ public:
   
   KPMRandom();
   void init_random();
+  void seed(unsigned);
+  std::string state();
+  void set_state(const std::string &);
   double get();  
   double uniform(double  mean, double  width);
   double gaussian(double  mean, double  width);
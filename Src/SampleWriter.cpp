@@ -0,0 +1,103 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "SampleWriter.hpp"
+
+template <typename T>
+SampleWriter<T>::SampleWriter(std::string file_name, std::vector<std::string> dataset_names, long row_width):
+  filename(file_name), names(dataset_names), width(row_width), finished(false){
+  worker = std::thread(&SampleWriter<T>::run, this);
+}
+
+
+template <typename T>
+SampleWriter<T>::~SampleWriter(){
+  // Waits for the pending samples to be written
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  ready.notify_one();
+  worker.join();
+}
+
+
+template <typename T>
+void SampleWriter<T>::push(const Eigen::Array<T,-1,-1> & sample){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(sample);
+  }
+  ready.notify_one();
+}
+
+
+template <typename T>
+void SampleWriter<T>::run(){
+  // The datasets start empty and grow by one row for each sample. The chunks hold
+  // about 1MB of rows, so short rows are not written one chunk at a time
+  auto datatype = hdf5_datatype<T>();
+  hsize_t dims[2]     = {0, hsize_t(width)};
+  hsize_t max_dims[2] = {H5S_UNLIMITED, hsize_t(width)};
+  hsize_t chunk[2]    = {hsize_t(std::max(1L, long((1 << 20)/(width*sizeof(T))))), hsize_t(width)};
+  H5::DSetCreatPropList plist;
+  plist.setChunk(2, chunk);
+
+  H5::H5File * file = new H5::H5File(filename, H5F_ACC_RDWR);
+  std::vector<H5::DataSet> datasets;
+  for(unsigned d = 0; d < names.size(); d++){
+    try{
+      H5::Exception::dontPrint();
+      file->unlink(names.at(d)); // samples of an earlier run
+    } catch(H5::Exception& e) {}
+    H5::DataSpace dataspace(2, dims, max_dims);
+    datasets.push_back(file->createDataSet(names.at(d), datatype, dataspace, plist));
+  }
+
+  hsize_t rows = 0;
+  while(true){
+    Eigen::Array<T,-1,-1> sample;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this]{return finished || !pending.empty();});
+      if(pending.empty())
+        break;
+      sample = std::move(pending.front());
+      pending.pop_front();
+    }
+
+    hsize_t size[2]   = {rows + 1, hsize_t(width)};
+    hsize_t offset[2] = {rows, 0};
+    hsize_t count[2]  = {1, hsize_t(width)};
+    H5::DataSpace memspace(2, count);
+    for(unsigned d = 0; d < datasets.size(); d++){
+      datasets.at(d).extend(size);
+      H5::DataSpace filespace = datasets.at(d).getSpace();
+      filespace.selectHyperslab(H5S_SELECT_SET, count, offset);
+      datasets.at(d).write(sample.col(d).data(), datatype, memspace, filespace);
+    }
+    rows++;
+  }
+
+  for(unsigned d = 0; d < datasets.size(); d++)
+    datasets.at(d).close();
+  file->close();
+  delete file;
+}
+
+
+template class SampleWriter<float>;
+template class SampleWriter<double>;
+template class SampleWriter<long double>;
+template class SampleWriter<std::complex<float>>;
+template class SampleWriter<std::complex<double>>;
+template class SampleWriter<std::complex<long double>>;
@@ -0,0 +1,28 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+// Appends samples to extendible HDF5 datasets from a separate thread, so the Chebyshev
+// iterations never wait for the file. Each sample has one column for each dataset, which
+// becomes a new row of that dataset. Nothing else may use the file until the writer is deleted
+template <typename T>
+class SampleWriter {
+  std::string                       filename;
+  std::vector<std::string>          names;
+  long                              width;     // length of each row
+  std::deque<Eigen::Array<T,-1,-1>> pending;   // samples not written yet
+  std::mutex                        mutex;
+  std::condition_variable           ready;
+  bool                              finished;
+  std::thread                       worker;
+  void run();
+public:
+  SampleWriter(std::string, std::vector<std::string>, long);
+  ~SampleWriter();
+  void push(const Eigen::Array<T,-1,-1> &);
+};
@@ -10,9 +10,11 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "Global.hpp"
+#include "Diagnostics.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
+#include "MemoryPlan.hpp"
 template <typename T, unsigned D>
 class Hamiltonian;
 template <typename T, unsigned D>
@@ -28,6 +30,11 @@ Simulation<T,D>::Simulation(char *filename, GLOBAL_VARIABLES <T> & Global1): r(f
   // Initializes the Hamiltonian h, an instance of Lattice Structure r, 
   // and an instance of GLOBAL_VARIABLES Global1
   ghosts.resize(Global.ghosts.size()/r.n_threads);
+
+  // Only the master of each team reports the progress
+  char *env = getenv("PROGRESS");
+  if(r.thread_id == 0)
+    progress.interval = (env != NULL) ? atof(env) : 60.0*ESTIMATE_TIME;
 }
 
 
@@ -49,13 +56,133 @@ void Simulation<T,D>::generalized_velocity(KPM_Vector<T,D>* kpm0, KPM_Vector<T,D
 }
 
 
+template <typename T,unsigned D>
+void Simulation<T,D>::velocity_or_copy(KPM_Vector<T,D>* kpm0, KPM_Vector<T,D>* kpm1, std::vector<std::vector<unsigned>> & indices, int pos){
+  // Same as generalized_velocity, but an empty set of indices copies kpm1 to kpm0, ghosts included
+  if(indices.at(pos).size() == 0)
+    kpm0->v.col(kpm0->get_index()) = kpm1->v.col(kpm1->get_index());
+  else
+    generalized_velocity(kpm0, kpm1, indices, pos);
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::gather_interior(KPM_Vector<T,D>* kpm, Eigen::Matrix<T,-1,-1> & dest, int col){
+  // Copies the current column of kpm, without the ghosts, into column col of dest.
+  // dest is packed line after line, in the same order as r.lines
+  T * kpmdata = kpm->v.col(kpm->get_index()).data();
+  for(std::size_t l = 0; l < r.lines.size(); l++)
+    dest.col(col).segment(l*r.ld[0], r.ld[0]) = Eigen::Map<Eigen::Matrix<T,-1,1>>(kpmdata + r.lines[l], r.ld[0]);
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::contract(Eigen::Matrix<T,-1,-1> & left, KPM_Vector<T,D>* right, Eigen::Matrix<T,-1,-1> & result){
+  // result = left^dagger * right, restricted to the sites of this thread.
+  // left has already been packed by gather_interior. The ghosts of right are skipped by
+  // copying GEMM_BLOCK rows at a time to a contiguous buffer, so each block is a single GEMM
+  ScopedTimer timer(Diagnostics::CONTRACT);
+  const std::size_t ld0 = r.ld[0];
+  const std::size_t n_lines = std::max(std::size_t(1), std::size_t(GEMM_BLOCK)/ld0);
+  const long cols = right->v.cols();
+  
+  gemm_block.resize(n_lines*ld0, cols);
+  result.setZero(left.cols(), cols);
+  
+  for(std::size_t l0 = 0; l0 < r.lines.size(); l0 += n_lines){
+    std::size_t l1 = std::min(l0 + n_lines, r.lines.size());
+    for(long c = 0; c < cols; c++)
+      for(std::size_t l = l0; l < l1; l++)
+        gemm_block.col(c).segment((l - l0)*ld0, ld0) = right->v.col(c).segment(r.lines[l], ld0);
+    
+    const long rows = (l1 - l0)*ld0;
+    result.noalias() += left.middleRows(l0*ld0, rows).adjoint() * gemm_block.topRows(rows);
+  }
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::contract_orbitals(Eigen::Matrix<T,-1,-1> & left, KPM_Vector<T,D>* right, Eigen::Matrix<T,-1,-1> & result){
+  ScopedTimer timer(Diagnostics::CONTRACT);
+  // Same as contract for a single left vector, split by orbital: row io of result only has
+  // the sites of orbital io. The lines are ordered by orbital, so each orbital is a range of
+  // lines and the blocks never mix two orbitals. The cost is the same as contract
+  const std::size_t ld0 = r.ld[0];
+  const std::size_t n_lines = std::max(std::size_t(1), std::size_t(GEMM_BLOCK)/ld0);
+  const std::size_t orbital_lines = r.lines.size()/r.Orb;
+  const long cols = right->v.cols();
+
+  gemm_block.resize(n_lines*ld0, cols);
+  result.setZero(r.Orb, cols);
+
+  for(std::size_t io = 0; io < r.Orb; io++)
+    for(std::size_t l0 = io*orbital_lines; l0 < (io + 1)*orbital_lines; l0 += n_lines){
+      std::size_t l1 = std::min(l0 + n_lines, (io + 1)*orbital_lines);
+      for(long c = 0; c < cols; c++)
+        for(std::size_t l = l0; l < l1; l++)
+          gemm_block.col(c).segment((l - l0)*ld0, ld0) = right->v.col(c).segment(r.lines[l], ld0);
+
+      const long rows = (l1 - l0)*ld0;
+      result.row(io).noalias() += left.middleRows(l0*ld0, rows).adjoint() * gemm_block.topRows(rows);
+    }
+}
+
+
 template <typename T,unsigned D>
 void Simulation<T,D>::cheb_iteration(KPM_Vector<T,D>* kpm, long int current_iteration){
   // Performs a chebyshev iteration
-  if(current_iteration == 0){
-    kpm->template Multiply<0>(); 
-  } else {
-    kpm->template Multiply<1>(); 
+  std::chrono::steady_clock::time_point t0;
+  if(progress.interval > 0)
+    t0 = std::chrono::steady_clock::now();
+
+  {
+    ScopedTimer timer(Diagnostics::MULTIPLY);
+    if(current_iteration == 0){
+      kpm->template Multiply<0>(); 
+    } else {
+      kpm->template Multiply<1>(); 
+    }
+  }
+
+  if(progress.interval > 0){
+    auto t1 = std::chrono::steady_clock::now();
+    progress.motor += std::chrono::duration<double>(t1 - t0).count();
+    progress.products++;
+    if(progress.samples > 0 && std::chrono::duration<double>(t1 - progress.last).count() >= progress.interval)
+      progress_report(false);
+  }
+}
+
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::doubling_moments(KPM_Vector<T,D>* kpm1, int N_moments, Eigen::Matrix<T,-1,1> & mu){
+  // Moments mu_n = <r|T_n|r> of the vector in the current column of kpm1 (two columns,
+  // ghosts already exchanged), using only N_moments/2 Chebyshev iterations. The products
+  // T_{2n} = 2T_n T_n - T_0 and T_{2n+1} = 2T_{n+1}T_n - T_1 give
+  //   mu_{2n} = 2<T_n|T_n> - mu_0,   mu_{2n+1} = 2<T_{n+1}|T_n> - mu_1
+  // Both sides are sums over the sites, so the identities also hold for the part of
+  // the moments of each thread
+  Eigen::Matrix<T,-1,-1> current(r.Size, 1), tmp;
+  mu = Eigen::Matrix<T,-1,1>::Zero(N_moments);
+
+  for(int k = 0; k <= N_moments/2; k++){
+    if(k != 0) cheb_iteration(kpm1, k - 1);
+    gather_interior(kpm1, current, 0);
+    contract(current, kpm1, tmp);
+
+    int index = kpm1->get_index();
+    T self  = tmp(0, index);                   // <T_k|T_k>
+    T cross = tmp(0, 1 - index);               // <T_k|T_{k-1}>
+    if(k == 0)
+      mu(0) = self;
+    else if(k == 1)
+      mu(1) = cross;
+    else if(2*k - 1 < N_moments)
+      mu(2*k - 1) = value_type(2)*cross - mu(1);
+
+    if(k > 0 && 2*k < N_moments)
+      mu(2*k) = value_type(2)*self - mu(0);
   }
 }
 
@@ -144,6 +271,62 @@ double Simulation<T,D>::time_kpm(int N_average){
 }
 
 
+template <typename T,unsigned D>
+int Simulation<T,D>::plan_stored_vectors(int N_vectors){
+  // Memory planner of GammaGeneral and GammaFused. Returns how many of N_vectors
+  // vectors (without ghosts) fit in the share of MEMORY_BUDGET of this thread. The ones
+  // that are not stored are recalculated in blocks of MEMORY, which needs the work space
+  // of the KPM_Vector with MEMORY columns
+  double budget = MEMORY_BUDGET;
+  char *env = getenv("MEMORY_BUDGET");
+  if(env != NULL)
+    budget = atof(env);
+
+  double vector_size = double(r.Size)*sizeof(T);
+  double available = budget*1024.0*1024.0/r.n_threads;
+  long fit = long(available/vector_size);
+
+  int stored;
+  if(fit >= N_vectors)
+    stored = N_vectors;
+  else {
+    // Leave room for the vectors that restart the recursion
+    fit -= MEMORY*double(r.Sized)/r.Size;
+    stored = fit < 2 ? 0 : int(fit);
+  }
+
+  debug_message("Memory planner: storing "); debug_message(stored);
+  debug_message(" of "); debug_message(N_vectors); debug_message(" vectors.\n");
+  return stored;
+}
+
+
+template <typename T,unsigned D>
+int Simulation<T,D>::gamma_block(std::vector<int> N_moments){
+  // Vectors in each block of Gamma2D: MEMORY, or fewer in the low-memory mode. The blocks
+  // have to divide the numbers of moments
+  int block = MemoryPlan::block();
+  while(N_moments.at(0)%block != 0 || N_moments.at(1)%block != 0)
+    block--;
+  return block;
+}
+
+
+template <typename T,unsigned D>
+bool Simulation<T,D>::share_gamma(std::vector<int> N_moments){
+  // In the low-memory mode, the threads of Gamma2D add their moments to matrices shared by
+  // all of them. The checkpoints and the stopping rules need the matrices of each thread
+  if(!MemoryPlan::low_memory())
+    return false;
+  if(sampling_active() || checkpoint.interval > 0 || checkpoint.restart || N_moments.at(0) != N_moments.at(1)){
+    if(r.thread_id == 0)
+      verbose_message("Low memory: the checkpoints, the stopping rules and rectangular matrices need a Gamma matrix in each thread. Keeping them.\n");
+    return false;
+  }
+  return true;
+}
+
+
 template class Simulation<float ,1u>;
 template class Simulation<double ,1u>;
 template class Simulation<long double ,1u>;
@@ -8,6 +8,112 @@
 
 
 
+// Work space shared by all the levels of the recursion in GammaGeneral
+template <typename T,unsigned D>
+struct GammaWorkspace {
+  std::vector<int>                   N_moments;
+  std::vector<std::vector<unsigned>> indices;
+  std::vector<long>                  stride;   // stride of each Chebyshev index in the flattened Gamma
+  std::vector<KPM_Vector<T,D>*>      kpm_cheb; // Chebyshev-iterated vectors of the bra, one for each depth
+  KPM_Vector<T,D>                  * kpm0;     // random vector
+  KPM_Vector<T,D>                  * kpm_v;    // bra vector multiplied by the last velocity
+  KPM_Vector<T,D>                  * kpm_seed; // last two stored ket vectors, with ghosts
+  KPM_Vector<T,D>                  * kpm_ket;  // ket vectors that are not stored, MEMORY at a time
+  Eigen::Matrix<T,-1,-1>             bra;      // block of bra vectors, without ghosts
+  Eigen::Matrix<T,-1,-1>             ket;      // stored ket vectors, without ghosts
+  Eigen::Matrix<T,-1,-1>             tmp;
+  int                                stored;   // number of stored ket vectors
+  long                               average;
+  long                               row0, row1;
+};
+
+// Running statistics of the samples of a Gamma matrix, one sample for each random vector
+// and disorder realisation. Welford's update keeps the mean and the sum of the squared
+// deviations, from which the standard error of every element follows
+template <typename T>
+class SampleWriter;
+
+template <typename T>
+struct Sampler {
+  typedef typename extract_value_type<T>::value_type value_type;
+  double                         tolerance = 0; // relative standard error at which the sampling stops, 0 to ignore
+  double                         budget = 0;    // wall-clock time in seconds after which the sampling stops, 0 to ignore
+  bool                           stream = false; // write every sample to the output file
+  SampleWriter<T>              * writer = nullptr;
+  long                           count;
+  Eigen::Array<T,-1,-1>          mean;
+  Eigen::Array<value_type,-1,-1> M2;
+  std::chrono::high_resolution_clock::time_point start;
+};
+
+// Partition of the sites used by the probing trace estimators. Each random vector is
+// restricted to the sites of one colour: the cells with the same position modulo period in
+// every direction and, with dilution, the same orbital
+struct Probing {
+  int                       period = 1;
+  bool                      dilution = false;
+  int                       colours = 1;
+  long                      next = 0;   // colour of the next random vector
+  Eigen::Array<int, -1, 1>  colour;     // colour of each site of this thread, -1 for the ghosts
+};
+
+// Chebyshev recursions kept by a run, so that a later run can continue them with more
+// moments. Each recursion keeps its last two vectors, and the DOS also its random vector.
+// The disorder realisation d of every thread is generated again from the seed seed + d
+template<typename T>
+struct Resume {
+  bool                                 save = false;    // keep the recursions of this run
+  bool                                 extend = false;  // continue the recursions of an earlier run
+  unsigned                             seed = 0;
+  int                                  moments = 0;     // moments of the kept recursions
+  int                                  per_disorder = 0;// recursions of each disorder realisation
+  std::vector<Eigen::Matrix<T,-1,1>>   vectors;         // vectors of this thread, with the ghosts
+};
+
+// Periodic checkpoints of the long Gamma matrices, written by a separate thread to name +
+// ".checkpoint". They keep the partial averages of every thread, the position in the loops
+// over the disorder realisations and the random vectors, and the state of the random number
+// generators, so that a run with Restart continues from the last one
+template <typename T>
+class CheckpointWriter;
+
+template<typename T>
+struct Checkpoint {
+  double                       interval = 0;    // seconds between checkpoints, 0 for none
+  bool                         restart = false; // continue from the checkpoint of an earlier run
+  std::string                  name_dataset;    // Gamma matrix being calculated
+  std::string                  disorder_state;  // disorder generator before the current realisation
+  CheckpointWriter<T>        * writer = nullptr;
+  std::chrono::high_resolution_clock::time_point last;
+};
+
+// Progress of the calculation of a team, reported by its master every PROGRESS seconds (an
+// environment variable, 60 by default when compiled with ESTIMATE_TIME) and also written to
+// the JSON file PROGRESS_FILE when it is set. A sample is a random vector of a disorder
+// realisation, or a position of the LDoS or a k vector of ARPES. The fraction done is
+// measured in products by the Hamiltonian, counting those of the first sample for each one
+struct Progress {
+  double                       interval = 0;    // seconds between reports, 0 for none
+  std::string                  name_dataset;
+  long                         samples = 0;
+  long                         done = 0;        // samples finished
+  long                         products = 0;    // products by the Hamiltonian
+  long                         per_sample = 0;  // products of the first sample
+  double                       motor = 0;       // seconds spent in the products
+  double                       bytes = 0;       // bytes read and written by each product
+  std::chrono::steady_clock::time_point start, last;
+};
+
+// Share of a calculation given to a team by the scheduler of GlobalSimulation. The LDOS and
+// ARPES are split into parts, each with the columns [first, first + size) of the output
+struct Job {
+  int                          teams = 1;       // teams that share the machine
+  int                          part = 0;
+  int                          parts = 1;
+  long                         first = 0;       // first column of this part
+  long                         total = 0;       // columns of the whole output
+};
+
 template <typename T,unsigned D>
 class Simulation : public ComplexTraits<T> {
 public:
@@ -16,26 +122,78 @@ public:
   typedef typename extract_value_type<T>::value_type value_type;
   KPMRandom <T>          rnd;
   std::vector<T>         ghosts;
+  Eigen::Matrix<T,-1,-1> gemm_block;
   LatticeStructure <D>   r;      
   GLOBAL_VARIABLES <T> & Global;
   char                 * name;
   Hamiltonian<T,D>       h;
+  Sampler<T>             sampler;
+  Probing                probing;
+  Resume<T>              resume;
+  Checkpoint<T>          checkpoint;
+  Job                    job;
+  Progress               progress;
+  std::vector<std::string> checkpointed; // datasets finished since the last restart
   
   Simulation(char *, GLOBAL_VARIABLES <T> &);
   void cheb_iteration(KPM_Vector<T,D>*, long int);
   void generalized_velocity(KPM_Vector<T,D> *, KPM_Vector<T,D> *, std::vector<std::vector<unsigned>>, int);
+  void gather_interior(KPM_Vector<T,D> *, Eigen::Matrix<T,-1,-1> &, int);
+  void contract(Eigen::Matrix<T,-1,-1> &, KPM_Vector<T,D> *, Eigen::Matrix<T,-1,-1> &);
+  void contract_orbitals(Eigen::Matrix<T,-1,-1> &, KPM_Vector<T,D> *, Eigen::Matrix<T,-1,-1> &);
+  void doubling_moments(KPM_Vector<T,D> *, int, Eigen::Matrix<T,-1,1> &);
   //void Measure_Gamma(measurement_queue);
 
-  void Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string );
-  void Gamma2D(int, int, std::vector<int>,  std::vector<std::vector<unsigned>>, std::string );
+  void Gamma1D(int, int, int, std::vector<std::vector<unsigned>>, std::string, bool doubling = false, bool orbitals = false);
+  void Gamma2D(int, int, std::vector<int>,  std::vector<std::vector<unsigned>>, std::string, bool symmetric = false);
+  void Gamma2D(int, int, std::vector<int>,  std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>, bool symmetric = false, std::string name_dos = "");
   void Gamma3D(int, int, std::vector<int>,  std::vector<std::vector<unsigned>>, std::string );
   void GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string );
-  void recursive_KPM(int, int, std::vector<int>, long *, long *,  std::vector<std::vector<unsigned>>, std::vector<KPM_Vector<T,D>*> *, Eigen::Array<T, -1, -1> *);
+  void GammaFused(int, int, int, std::vector<std::vector<std::vector<unsigned>>>, std::vector<std::string>);
+  void recursive_KPM(int, long, GammaWorkspace<T,D> &);
+  void contract_general(long, int, GammaWorkspace<T,D> &);
+  void velocity_or_copy(KPM_Vector<T,D> *, KPM_Vector<T,D> *, std::vector<std::vector<unsigned>> &, int);
+  int  plan_stored_vectors(int);
+  int  gamma_block(std::vector<int>);
+  bool share_gamma(std::vector<int>);
   void store_gamma(Eigen::Array<T, -1, -1> *, std::vector<int>,  std::vector<std::vector<unsigned>>, std::string );
+  void store_shared_gamma(Eigen::Array<T, -1, -1> &, std::vector<int>, int, std::string);
   void store_gamma1D(Eigen::Array<T, -1, -1> *, std::string );
   void store_gamma3D(Eigen::Array<T, -1, -1> *, std::vector<int>, std::vector<std::vector<unsigned>>, std::string );
   std::vector<std::vector<unsigned>> process_string(std::string);
   double time_kpm(int);
+  void progress_start(std::string, long);
+  void progress_sample();
+  void progress_report(bool);
+  void progress_finish();
+
+  void read_sampling(H5::H5File *, std::string);
+  bool sampling_active();
+  void start_sampling(long, long, std::vector<std::string>);
+  void finish_sampling();
+  bool sample_converged(Eigen::Array<T, -1, -1> &);
+  double sampling_error();
+  int  read_probing(H5::H5File *, std::string);
+  int  probing_colour(std::size_t *);
+  void mask_vector(KPM_Vector<T,D> *, int, value_type);
+  void probe_vector(KPM_Vector<T,D> *);
+  void project_sample(Eigen::Array<T, -1, -1> &, int, long, int, bool);
+  void store_sampling(std::string, int, long);
+  void store_weight(std::string, long);
+  void read_resume(H5::H5File *, std::string, std::string);
+  void seed_disorder(int);
+  void keep_vector(KPM_Vector<T,D> *, int);
+  void store_resume(std::string, int, int);
+  void extend_Gamma1D(int, std::string);
+  void extend_LMU(int, Eigen::Array<unsigned long, -1, 1>);
+  void read_checkpoint(H5::H5File *, std::string);
+  bool start_checkpoint(std::string, std::vector<Eigen::Array<T, -1, -1>*>, int &, int &, long &);
+  void checkpoint_disorder();
+  void save_checkpoint(int, int, long, std::vector<Eigen::Array<T, -1, -1>*>);
+  void stop_checkpoint();
+  long job_share(long);
+  void store_part(Eigen::Array<T, -1, -1> &, std::string);
+  void finish_checkpoint(std::string);
 
   void calc_singleshot();
   void singleshot(Eigen::Array<double, -1, 1> energies,
@@ -46,26 +204,29 @@ public:
 
   
   void calc_conddc();
-  void CondDC(int, int, int, int);
+  void CondDC(int, int, int, std::vector<int>, int, int);
   
   void calc_condopt();
-  void CondOpt(int, int, int, int);
+  void CondOpt(int, int, int, int, int, int, int);
 
   void calc_condopt2();
-  void CondOpt2(int, int, int, int, int);
+  void CondOpt2(int, int, int, int, int, int, int);
+
+  void calc_gamma();
 
   void calc_DOS();
-  void DOS(int, int, int);
+  void DOS(int, int, int, int, int);
   void store_MU(Eigen::Array<T, -1, -1> *);
 
   void Gaussian_Wave_Packet();
   void calc_wavepacket();
 
-  void LMU(int, int, Eigen::Array<unsigned long, -1, 1>);
+  void LMU(int, int, Eigen::Array<unsigned long, -1, 1>, int);
+  void LMU_probing(int, int, Eigen::Array<unsigned long, -1, 1>);
   void calc_LDOS();
   void store_LMU(Eigen::Array<T, -1, -1> *);
 	
   void calc_ARPES();
-  void ARPES(int NDisorder, int NMoments, Eigen::Array<double, -1, -1> & k_vectors, Eigen::Matrix<T, -1, 1> & weight);
+  void ARPES(int NDisorder, int NMoments, Eigen::Array<double, -1, -1> & k_vectors, Eigen::Matrix<T, -1, 1> & weight, int doubling);
   void store_ARPES(Eigen::Array<T, -1, -1> *);
 };
@@ -10,7 +10,9 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
 #include "Global.hpp"
+#include "Diagnostics.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
@@ -27,6 +29,7 @@ class KPM_Vector;
 template <typename T,unsigned D>
 void Simulation<T,D>::store_ARPES(Eigen::Array<T, -1, -1> *gamma){
     debug_message("Entered store_ARPES\n");
+    ScopedTimer timer(Diagnostics::STORE);
 
     // Make sure that all the threads are ready before opening any files
     // Some threads could still be inside the Simulation constructor
@@ -49,25 +52,30 @@ void Simulation<T,D>::store_ARPES(Eigen::Array<T, -1, -1> *gamma){
 {
     //std::cout << "Printing huge matrix, brb\n";
     //std::cout << Global.general_gamma << "\n";
-    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
-    write_hdf5(Global.general_gamma, file, "/Calculation/arpes/kMU");
-    file->close();
-    delete file;
+    if(job.parts > 1)
+      store_part(Global.general_gamma, "/Calculation/arpes/kMU");
+    else{
+      H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+      write_hdf5(Global.general_gamma, file, "/Calculation/arpes/kMU");
+      file->close();
+      delete file;
+    }
 }
 #pragma omp barrier    
     debug_message("Left store_lmu\n");
   }
 
 template <typename T,unsigned D>
-void Simulation<T,D>::ARPES(int NDisorder, int NMoments, Eigen::Array<double, -1, -1> & k_vectors, Eigen::Matrix<T, -1, 1> & weight){
+void Simulation<T,D>::ARPES(int NDisorder, int NMoments, Eigen::Array<double, -1, -1> & k_vectors, Eigen::Matrix<T, -1, 1> & weight, int doubling){
     typedef typename extract_value_type<T>::value_type value_type;
 
-    Eigen::Matrix<T, 1, 2> tmp;
+    Eigen::Matrix<T, -1, -1> tmp;
     int Nk_vectors = k_vectors.rows();
     Eigen::Matrix<double, -1, 1> k;
 
     KPM_Vector<T,D> kpm0(1, *this); // initial random vector
     KPM_Vector<T,D> kpm1(2, *this); // left vector that will be Chebyshev-iterated on
+    Eigen::Matrix<T, -1, -1> kpm0_interior(r.Size, 1); // kpm0 without the ghosts
 
     // initialize the local gamma matrix and set it to 0
     Eigen::Array<T, -1, -1> gamma = Eigen::Array<T, -1, -1 >::Zero(NMoments, Nk_vectors);
@@ -77,6 +85,7 @@ void Simulation<T,D>::ARPES(int NDisorder, int NMoments, Eigen::Array<double, -1
     average = Eigen::Array<long, -1, 1>::Zero(Nk_vectors,1);
 
     // start the kpm iteration
+    progress_start("/Calculation/arpes/kMU", long(NDisorder)*Nk_vectors);
     for(int disorder = 0; disorder < NDisorder; disorder++){
         h.generate_disorder();
 
@@ -91,24 +100,34 @@ void Simulation<T,D>::ARPES(int NDisorder, int NMoments, Eigen::Array<double, -1
 
             kpm1.set_index(0);
             kpm1.v.col(0) = kpm0.v.col(0);
-            kpm0.empty_ghosts(0);
+            gather_interior(&kpm0, kpm0_interior, 0);
+
+            if(doubling){
+                Eigen::Matrix<T, -1, 1> mu;
+                doubling_moments(&kpm1, NMoments, mu);
+                gamma.matrix().col(k_index) += (mu - gamma.matrix().col(k_index))/value_type(average(k_index) + 1);
+                average(k_index)++;
+                progress_sample();
+                continue;
+            }
 
             for(int n = 0; n < NMoments; n+=2){
                 for(int i = n; i < n+2; i++)
                     if(i!=0) cheb_iteration(&kpm1, i-1);
 
               
-                tmp.setZero();
-                for(std::size_t ii = 0; ii < r.Sized ; ii += r.Ld[0])
-                    tmp += kpm0.v.block(ii,0, r.Ld[0], 1).adjoint() * kpm1.v.block(ii, 0, r.Ld[0], 2);
+                contract(kpm0_interior, &kpm1, tmp);
 
                 gamma(n, k_index) += (tmp(0,0) - gamma(n, k_index))/value_type(average(k_index) + 1);			
                 gamma(n+1, k_index) += (tmp(0,1) - gamma(n+1, k_index))/value_type(average(k_index) + 1);			
             }
             average(k_index)++;
+            progress_sample();
         } 
     }
+    progress_finish();
     store_ARPES(&gamma);
+    store_weight("/Calculation/arpes/kMU", NDisorder);
 }
 
 template <typename T, unsigned DIM>
@@ -122,21 +141,20 @@ void Simulation<T, DIM>::calc_ARPES(){
     bool local_calculate_arpes = false;
 #pragma omp master
 {
-    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
         Global.calculate_arpes = false;
     try{
         int dummy_var;
         get_hdf5<int>(&dummy_var, file, (char *) "/Calculation/arpes/NumDisorder");
         Global.calculate_arpes = true;
     } catch(H5::Exception& e) {debug_message("ARPES: no need to calculate.\n");}
-        file->close();  
-        delete file;
 }
 #pragma omp barrier
 
 
       int NumDisorder;
       int NumMoments;
+      int Doubling = 0;
       Eigen::Array<double, -1, -1> k_vectors;
       Eigen::Matrix<T, -1, 1> weight;
     // Fetch the data from the hdf file
@@ -153,7 +171,7 @@ void Simulation<T, DIM>::calc_ARPES(){
       H5::DataSet * dataset;
       H5::DataSpace * dataspace;
       hsize_t dim_k[2], dim_w[2];
-      H5::H5File * file  = new H5::H5File(name, H5F_ACC_RDONLY);
+      H5::H5File * file = Config::open(name);
       dataset            = new H5::DataSet(file->openDataSet("/Calculation/arpes/k_vector")  );
       dataspace          = new H5::DataSpace(dataset->getSpace());
       dataspace -> getSimpleExtentDims(dim_k, NULL);
@@ -190,9 +208,11 @@ void Simulation<T, DIM>::calc_ARPES(){
       get_hdf5    <int>(&NumMoments,     file, (char *) "/Calculation/arpes/NumMoments" );
       get_hdf5 <double>(weight_test.data(),   file, (char *) "/Calculation/arpes/OrbitalWeights");
       get_hdf5 <double>(k_vectors.data(), file, (char *) "/Calculation/arpes/k_vector");
+      try{
+        H5::Exception::dontPrint();
+        get_hdf5<int>(&Doubling, file, (char *) "/Calculation/arpes/Doubling");
+      } catch(H5::Exception& e) {}
 
-      file->close();  
-      delete file;
 
       for(unsigned i = 0; i < r.Orb; i++)
         weight(i) = T(weight_test(i));
@@ -207,7 +227,14 @@ void Simulation<T, DIM>::calc_ARPES(){
 
      Eigen::Array<double, -1, -1> k_transposed;
      k_transposed = k_vectors.transpose();
-     ARPES(NumDisorder, NumMoments, k_transposed, weight);
+
+     // With several teams, each one has a part of the k vectors
+     if(job.parts > 1){
+       long size = job_share(k_transposed.rows());
+       k_transposed = k_transposed.middleRows(job.first, size).eval();
+     }
+     if(k_transposed.rows() > 0)
+       ARPES(NumDisorder, NumMoments, k_transposed, weight, Doubling);
     }
 
 }
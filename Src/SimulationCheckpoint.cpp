@@ -0,0 +1,230 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Global.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+template <typename T, unsigned D>
+class Hamiltonian;
+template <typename T, unsigned D>
+class KPM_Vector;
+#include "CheckpointWriter.hpp"
+#include "Simulation.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+#include <sstream>
+
+template <typename T,unsigned D>
+void Simulation<T,D>::read_checkpoint(H5::H5File * file, std::string group){
+  // Reads the optional CheckpointInterval, in seconds, and Restart of a calculation
+  int restart = 0;
+  checkpoint = Checkpoint<T>();
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<double>(&checkpoint.interval, file, (char *) (group + "CheckpointInterval").c_str());
+  } catch(H5::Exception& e) {}
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&restart, file, (char *) (group + "Restart").c_str());
+  } catch(H5::Exception& e) {}
+  checkpoint.restart = restart;
+}
+
+
+template <typename T,unsigned D>
+bool Simulation<T,D>::start_checkpoint(std::string name_dataset, std::vector<Eigen::Array<T, -1, -1>*> arrays,
+                                       int & disorder, int & random, long & average){
+  // Called by every thread before the loops of a Gamma matrix, with the arrays of this thread
+  // that hold its partial averages. With Restart, these, the position in the loops and the
+  // random number generators are those of the last checkpoint of name_dataset. Returns false
+  // if name_dataset was already finished by the earlier run
+  if(checkpoint.interval <= 0 && !checkpoint.restart)
+    return true;
+  if(sampling_active()){
+    verbose_message("Checkpoint: the sampling with stopping rules is not checkpointed. Ignoring.\n");
+    checkpoint.interval = 0;
+    checkpoint.restart = false;
+    return true;
+  }
+  if(job.teams > 1){
+    verbose_message("Checkpoint: the calculations of several teams are not checkpointed. Ignoring.\n");
+    checkpoint.interval = 0;
+    checkpoint.restart = false;
+    return true;
+  }
+
+  checkpoint.name_dataset = name_dataset;
+  bool finished = false, restored = false;
+  if(checkpoint.restart){
+    CheckpointState<T> state;
+#pragma omp critical
+    read_checkpoint_file(std::string(name) + ".checkpoint", state, r.thread_id);
+    for(auto & done : state.done)
+      if(std::find(checkpointed.begin(), checkpointed.end(), done) == checkpointed.end())
+        checkpointed.push_back(done);
+    finished = std::find(checkpointed.begin(), checkpointed.end(), name_dataset) != checkpointed.end();
+
+    long size = 0;
+    for(auto array : arrays)
+      size += array->size();
+    if(!finished && state.name_dataset == name_dataset){
+      if(state.threads != r.n_threads || state.arrays.at(0).size() != size){
+        std::cout << "Cannot restart " << name_dataset << " with a different number of threads or moments. Exiting.\n";
+        exit(0);
+      }
+      long offset = 0;
+      for(auto array : arrays){
+        *array = Eigen::Map<Eigen::Array<T, -1, -1>>(state.arrays.at(0).data() + offset, array->rows(), array->cols());
+        offset += array->size();
+      }
+      std::istringstream stream(state.states.at(0));
+      std::string line;
+      std::getline(stream, line);
+      rnd.set_state(line);
+      std::getline(stream, line);
+      h.rnd.set_state(line);
+      stream >> probing.next;
+      disorder = state.disorder;
+      random = state.random;
+      average = state.average;
+      restored = true;
+    }
+  }
+
+#pragma omp master
+  {
+    if(finished)
+      std::cout << name_dataset << " was finished before the restart. Skipping it.\n";
+    if(restored)
+      std::cout << "Restarting " << name_dataset << " from random vector " << random
+                << " of disorder realisation " << disorder << ".\n";
+    if(!finished && checkpoint.interval > 0){
+      Global.checkpoint.assign(r.n_threads, Eigen::Array<T, -1, -1>());
+      Global.checkpoint_state.assign(r.n_threads, "");
+      checkpoint.writer = new CheckpointWriter<T>(std::string(name) + ".checkpoint");
+      checkpoint.last = std::chrono::high_resolution_clock::now();
+    }
+  }
+#pragma omp barrier
+  return !finished;
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::checkpoint_disorder(){
+  // Keeps the state of the disorder generator before a new realisation is generated
+  if(checkpoint.interval > 0)
+    checkpoint.disorder_state = h.rnd.state();
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::save_checkpoint(int disorder, int random, long average, std::vector<Eigen::Array<T, -1, -1>*> arrays){
+  // Called by every thread after each random vector. Once the interval has passed, the threads
+  // pack their state into Global and the master hands it to the writer. The next random vector
+  // is number random of disorder realisation number disorder
+  if(checkpoint.interval <= 0)
+    return;
+#pragma omp master
+  {
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - checkpoint.last;
+    Global.save_checkpoint = elapsed.count() > checkpoint.interval;
+  }
+#pragma omp barrier
+  if(!Global.save_checkpoint)
+    return;
+
+  long size = 0;
+  for(auto array : arrays)
+    size += array->size();
+  Eigen::Array<T, -1, -1> & packed = Global.checkpoint.at(r.thread_id);
+  packed.resize(size, 1);
+  long offset = 0;
+  for(auto array : arrays){
+    packed.block(offset, 0, array->size(), 1) = Eigen::Map<Eigen::Array<T, -1, 1>>(array->data(), array->size());
+    offset += array->size();
+  }
+  std::ostringstream stream;
+  stream << rnd.state() << '\n' << checkpoint.disorder_state << '\n' << probing.next;
+  Global.checkpoint_state.at(r.thread_id) = stream.str();
+#pragma omp barrier
+
+#pragma omp master
+  {
+    CheckpointState<T> state;
+    state.done = checkpointed;
+    state.name_dataset = checkpoint.name_dataset;
+    state.disorder = disorder;
+    state.random = random;
+    state.average = average;
+    state.arrays = std::move(Global.checkpoint);
+    state.states = Global.checkpoint_state;
+    checkpoint.writer->push(std::move(state));
+    Global.checkpoint.assign(r.n_threads, Eigen::Array<T, -1, -1>());
+    checkpoint.last = std::chrono::high_resolution_clock::now();
+  }
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::stop_checkpoint(){
+  // Waits for the checkpoint that is still being written, before the results use the file
+#pragma omp master
+  {
+    delete checkpoint.writer;
+    checkpoint.writer = nullptr;
+  }
+#pragma omp barrier
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::finish_checkpoint(std::string name_dataset){
+  // Called by every thread once name_dataset is stored. The checkpoint only keeps its name, so
+  // that a restart skips it
+  if(checkpoint.interval <= 0 && !checkpoint.restart)
+    return;
+  checkpointed.push_back(name_dataset);
+#pragma omp master
+  if(checkpoint.interval > 0){
+    CheckpointState<T> state;
+    state.done = checkpointed;
+    CheckpointWriter<T> writer(std::string(name) + ".checkpoint");
+    writer.push(std::move(state));
+  }
+#pragma omp barrier
+}
+
+
+template class Simulation<float ,1u>;
+template class Simulation<double ,1u>;
+template class Simulation<long double ,1u>;
+template class Simulation<std::complex<float> ,1u>;
+template class Simulation<std::complex<double> ,1u>;
+template class Simulation<std::complex<long double> ,1u>;
+
+template class Simulation<float ,3u>;
+template class Simulation<double ,3u>;
+template class Simulation<long double ,3u>;
+template class Simulation<std::complex<float> ,3u>;
+template class Simulation<std::complex<double> ,3u>;
+template class Simulation<std::complex<long double> ,3u>;
+
+template class Simulation<float ,2u>;
+template class Simulation<double ,2u>;
+template class Simulation<long double ,2u>;
+template class Simulation<std::complex<float> ,2u>;
+template class Simulation<std::complex<double> ,2u>;
+template class Simulation<std::complex<long double> ,2u>;
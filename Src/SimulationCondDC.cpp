@@ -10,6 +10,7 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
 #include "Global.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
@@ -33,19 +34,18 @@ void Simulation<T,D>::calc_conddc(){
     // This barrier is essential
 #pragma omp barrier
 
-  int NMoments, NRandom, NDisorder, direction;
+  int NMoments, NRandom, NDisorder, direction, symmetric = 0, harvest_dos = 0;
+  std::vector<int> directions;
   bool local_calculate_conddc = false;
 #pragma omp master
 {
-  H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+  H5::H5File * file = Config::open(name);
   Global.calculate_conddc = false;
   try{
     int dummy_variable;
     get_hdf5<int>(&dummy_variable,  file, (char *)   "/Calculation/conductivity_dc/NumMoments");
     Global.calculate_conddc = true;
   } catch(H5::Exception& e) {debug_message("CondDC: no need to calculate CondDC.\n");}
-  file->close();
-  delete file;
 }
 #pragma omp barrier
 #pragma omp critical
@@ -61,7 +61,7 @@ if(local_calculate_conddc){
 #pragma omp barrier
 #pragma omp critical
 {
-    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
 
     debug_message("DC conductivity: checking if we need to calculate DC conductivity.\n");
     get_hdf5<int>(&direction, file, (char *) "/Calculation/conductivity_dc/Direction");
@@ -69,20 +69,61 @@ if(local_calculate_conddc){
     get_hdf5<int>(&NRandom, file, (char *)   "/Calculation/conductivity_dc/NumRandoms");
     get_hdf5<int>(&NDisorder, file, (char *) "/Calculation/conductivity_dc/NumDisorder");
 
-    file->close();
-    delete file;
+    // Optional: only calculate half of the Gamma matrix for longitudinal directions
+    try{
+      H5::Exception::dontPrint();
+      get_hdf5<int>(&symmetric, file, (char *) "/Calculation/conductivity_dc/Symmetric");
+    } catch(H5::Exception& e) {}
+
+    // Optional: several directions calculated with the same random vectors. Direction
+    // keeps the first one, which is the one read by KITE-tools
+    try{
+      H5::Exception::dontPrint();
+      hsize_t dim_directions[1];
+      H5::DataSet dataset = file->openDataSet("/Calculation/conductivity_dc/Directions");
+      dataset.getSpace().getSimpleExtentDims(dim_directions, NULL);
+      directions.resize(dim_directions[0]);
+      get_hdf5<int>(directions.data(), file, (char *) "/Calculation/conductivity_dc/Directions");
+    } catch(H5::Exception& e) {}
+    if(directions.size() == 0)
+      directions.push_back(direction);
+
+    // Optional: obtain the DOS moments from the same random vectors
+    try{
+      H5::Exception::dontPrint();
+      get_hdf5<int>(&harvest_dos, file, (char *) "/Calculation/conductivity_dc/HarvestDOS");
+    } catch(H5::Exception& e) {}
+
+    // Optional: stop the sampling at a target error or after a time budget
+    read_sampling(file, "/Calculation/conductivity_dc/");
+
+    // Optional: split every random vector into probing vectors, one for each colour
+    NRandom *= read_probing(file, "/Calculation/conductivity_dc/");
+
+    // Optional: write checkpoints periodically, and continue from them after a restart
+    read_checkpoint(file, "/Calculation/conductivity_dc/");
+
 
 }
-  CondDC(NMoments, NRandom, NDisorder, direction);
+  CondDC(NMoments, NRandom, NDisorder, directions, symmetric, harvest_dos);
+  sampler = Sampler<T>();
+  probing = Probing();
+  checkpoint = Checkpoint<T>();
   }
 
 }
 template <typename T,unsigned D>
 
-void Simulation<T,D>::CondDC(int NMoments, int NRandom, int NDisorder, int direction){
-  std::string dir(num2str2(direction));
-  std::string dirc = dir.substr(0,1)+","+dir.substr(1,2);
-  Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, process_string(dirc), "/Calculation/conductivity_dc/Gamma"+dir);
+void Simulation<T,D>::CondDC(int NMoments, int NRandom, int NDisorder, std::vector<int> directions, int symmetric, int harvest_dos){
+  std::vector<std::vector<std::vector<unsigned>>> components;
+  std::vector<std::string> names;
+  for(unsigned i = 0; i < directions.size(); i++){
+    std::string dir(num2str2(directions.at(i)));
+    std::string dirc = dir.substr(0,1)+","+dir.substr(1,2);
+    components.push_back(process_string(dirc));
+    names.push_back("/Calculation/conductivity_dc/Gamma"+dir);
+  }
+  Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, components, names, symmetric, harvest_dos ? "/Calculation/dos/MU" : "");
 }
 
 
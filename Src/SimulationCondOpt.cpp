@@ -12,6 +12,7 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
 #include "Global.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
@@ -35,19 +36,17 @@ void Simulation<T,D>::calc_condopt(){
     // This barrier is essential
 #pragma omp barrier
 
-  int NMoments, NRandom, NDisorder, direction;
+  int NMoments, NRandom, NDisorder, direction, symmetric = 0, fused = 0, harvest_dos = 0;
   bool local_calculate_condopt = false;
 #pragma omp master
 {
-  H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+  H5::H5File * file = Config::open(name);
   Global.calculate_condopt = false;
   try{
     int dummy_variable;
     get_hdf5<int>(&dummy_variable,  file, (char *)   "/Calculation/conductivity_optical/NumMoments");
     Global.calculate_condopt = true;
   } catch(H5::Exception& e) {debug_message("CondOpt: no need to calculate CondOpt.\n");}
-  file->close();
-  delete file;
 }
 #pragma omp barrier
 #pragma omp critical
@@ -64,7 +63,7 @@ if(local_calculate_condopt){
 
 #pragma omp critical
 {
-    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
 
     debug_message("Optical conductivity: checking if we need to calculate Condopt.\n");
     get_hdf5<int>(&direction, file, (char *) "/Calculation/conductivity_optical/Direction");
@@ -72,21 +71,64 @@ if(local_calculate_condopt){
     get_hdf5<int>(&NRandom, file, (char *)   "/Calculation/conductivity_optical/NumRandoms");
     get_hdf5<int>(&NDisorder, file, (char *)   "/Calculation/conductivity_optical/NumDisorder");
 
-    file->close();
-    delete file;
+    // Optional: only calculate half of the Gamma matrix for longitudinal directions
+    try{
+      H5::Exception::dontPrint();
+      get_hdf5<int>(&symmetric, file, (char *) "/Calculation/conductivity_optical/Symmetric");
+    } catch(H5::Exception& e) {}
+
+    // Optional: calculate Lambda and Gamma in the same sweep
+    try{
+      H5::Exception::dontPrint();
+      get_hdf5<int>(&fused, file, (char *) "/Calculation/conductivity_optical/Fused");
+    } catch(H5::Exception& e) {}
+
+    // Optional: obtain the DOS moments from the same random vectors
+    try{
+      H5::Exception::dontPrint();
+      get_hdf5<int>(&harvest_dos, file, (char *) "/Calculation/conductivity_optical/HarvestDOS");
+    } catch(H5::Exception& e) {}
+
+    // Optional: stop the sampling of Lambda and Gamma at a target error or after a time budget
+    read_sampling(file, "/Calculation/conductivity_optical/");
+
+    // Optional: split every random vector into probing vectors, one for each colour
+    NRandom *= read_probing(file, "/Calculation/conductivity_optical/");
+
+    // Optional: write checkpoints periodically, and continue from them after a restart
+    read_checkpoint(file, "/Calculation/conductivity_optical/");
+
 
 }
-  CondOpt(NMoments, NRandom, NDisorder, direction);
+  CondOpt(NMoments, NRandom, NDisorder, direction, symmetric, fused, harvest_dos);
+  sampler = Sampler<T>();
+  probing = Probing();
+  checkpoint = Checkpoint<T>();
   }
 
 }
 template <typename T,unsigned D>
 
-void Simulation<T,D>::CondOpt(int NMoments, int NRandom, int NDisorder, int direction){
+void Simulation<T,D>::CondOpt(int NMoments, int NRandom, int NDisorder, int direction, int symmetric, int fused, int harvest_dos){
   std::string dir(num2str2(direction));
   std::string dirc = dir.substr(0,1)+","+dir.substr(1,2);
+  if(fused){
+    if(sampling_active())
+      verbose_message("CondOpt: the fused sweep does not stop the sampling early. Using all the random vectors.\n");
+    std::vector<std::vector<std::vector<unsigned>>> objects = {process_string(dir), process_string(dirc)};
+    std::vector<std::string> names = {"/Calculation/conductivity_optical/Lambda"+dir, "/Calculation/conductivity_optical/Gamma"+dir};
+    if(harvest_dos){
+      objects.push_back(process_string(""));
+      names.push_back("/Calculation/dos/MU");
+    }
+    GammaFused(NRandom, NDisorder, NMoments, objects, names);
+    return;
+  }
   Gamma1D(NRandom, NDisorder, NMoments, process_string(dir), "/Calculation/conductivity_optical/Lambda"+dir);
-  Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, process_string(dirc), "/Calculation/conductivity_optical/Gamma"+dir);
+  if(harvest_dos)
+    Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, {process_string(dirc)}, {"/Calculation/conductivity_optical/Gamma"+dir}, symmetric, "/Calculation/dos/MU");
+  else
+    Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, process_string(dirc), "/Calculation/conductivity_optical/Gamma"+dir, symmetric);
 }
 
 
@@ -11,6 +11,7 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
 #include "Global.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
@@ -34,19 +35,17 @@ void Simulation<T,D>::calc_condopt2(){
     // This barrier is essential
 #pragma omp barrier
 
-  int NMoments, NRandom, NDisorder, direction, special;
+  int NMoments, NRandom, NDisorder, direction, special, fused = 0, harvest_dos = 0;
   bool local_calculate_condopt2 = false;
 #pragma omp master
 {
-  H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+  H5::H5File * file = Config::open(name);
   Global.calculate_condopt2 = false;
   try{
     int dummy_variable;
     get_hdf5<int>(&dummy_variable,  file, (char *)   "/Calculation/conductivity_optical_nonlinear/NumMoments");
     Global.calculate_condopt2 = true;
   } catch(H5::Exception& e) {debug_message("Condopt2: no need to calculate Condopt2.\n");}
-  file->close();
-  delete file;
 }
 #pragma omp barrier
 #pragma omp critical
@@ -62,7 +61,7 @@ if(local_calculate_condopt2){
 #pragma omp barrier
 #pragma omp critical
 {
-    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
 
     debug_message("Optical conductivity: checking if we need to calculate Condopt.\n");
     get_hdf5<int>(&direction, file, (char *) "/Calculation/conductivity_optical_nonlinear/Direction");
@@ -71,36 +70,72 @@ if(local_calculate_condopt2){
     get_hdf5<int>(&NDisorder, file, (char *)   "/Calculation/conductivity_optical_nonlinear/NumDisorder");
     get_hdf5<int>(&special, file, (char *)   "/Calculation/conductivity_optical_nonlinear/Special");
 
-    file->close();
-    delete file;
+    // Optional: calculate all the Gamma matrices in the same sweep
+    try{
+      H5::Exception::dontPrint();
+      get_hdf5<int>(&fused, file, (char *) "/Calculation/conductivity_optical_nonlinear/Fused");
+    } catch(H5::Exception& e) {}
+
+    // Optional: obtain the DOS moments from the same random vectors
+    try{
+      H5::Exception::dontPrint();
+      get_hdf5<int>(&harvest_dos, file, (char *) "/Calculation/conductivity_optical_nonlinear/HarvestDOS");
+    } catch(H5::Exception& e) {}
+
+    // Optional: split every random vector into probing vectors, one for each colour
+    NRandom *= read_probing(file, "/Calculation/conductivity_optical_nonlinear/");
+
+    // Optional: write checkpoints periodically, and continue from them after a restart
+    read_checkpoint(file, "/Calculation/conductivity_optical_nonlinear/");
+
 
 }
-  CondOpt2(NMoments, NRandom, NDisorder, direction, special);
+  CondOpt2(NMoments, NRandom, NDisorder, direction, special, fused, harvest_dos);
+  probing = Probing();
+  checkpoint = Checkpoint<T>();
   }
 
 }
 template <typename T,unsigned D>
 
-void Simulation<T,D>::CondOpt2(int NMoments, int NRandom, int NDisorder, int direction, int special){
+void Simulation<T,D>::CondOpt2(int NMoments, int NRandom, int NDisorder, int direction, int special, int fused, int harvest_dos){
     std::string dir(num2str3(direction));                                                // xxx Gamma0
     std::string dirc1 = dir.substr(0,1) + "," + dir.substr(1,2);                         // x,xx Gamma1
     std::string dirc2 = dir.substr(0,2) + "," + dir.substr(2,1);                         // xx,x Gamma2
     std::string dirc3 = dir.substr(0,1) + "," + dir.substr(1,1) + "," + dir.substr(2,1); // x,x,x Gamma3
 
     std::string directory = "/Calculation/conductivity_optical_nonlinear/";
+    std::string name_dos = harvest_dos ? "/Calculation/dos/MU" : "";
        
-    // regular nonlinear calculation
-    if(special != 1){
+    // regular nonlinear calculation, with all the Gamma matrices obtained from the same recursions
+    if(special != 1 && fused){
+      std::vector<std::vector<std::vector<unsigned>>> objects =
+        {process_string(dir), process_string(dirc1), process_string(dirc2), process_string(dirc3)};
+      std::vector<std::string> names =
+        {directory + "Gamma0" + dir, directory + "Gamma1" + dir, directory + "Gamma2" + dir, directory + "Gamma3" + dir};
+      if(harvest_dos){
+        objects.push_back(process_string(""));
+        names.push_back(name_dos);
+      }
+      GammaFused(NRandom, NDisorder, NMoments, objects, names);
+    }
+
+    // regular nonlinear calculation. The DOS moments, if needed, come with Gamma1
+    if(special != 1 && !fused){
       Gamma1D(NRandom, NDisorder, NMoments, process_string(dir), directory + "Gamma0" + dir);
-      Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, process_string(dirc1), directory + "Gamma1" + dir);
+      Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, {process_string(dirc1)}, {directory + "Gamma1" + dir}, false, name_dos);
       Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, process_string(dirc2), directory + "Gamma2" + dir);
       Gamma3D(NRandom, NDisorder, {NMoments,NMoments, NMoments}, process_string(dirc3), directory + "Gamma3" + dir);
     }
 
     // special nonlinear calculation. In this case, it's going to be HBN, which is nonlinear
     // but only has simple objects that need calculating
-    if(special == 1){
-      Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, process_string(dirc1), directory + "Gamma1" + dir);
+    if(special == 1 && fused){
+      Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, {process_string(dirc1), process_string(dirc2)},
+              {directory + "Gamma1" + dir, directory + "Gamma2" + dir}, false, name_dos);
+    }
+    if(special == 1 && !fused){
+      Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, {process_string(dirc1)}, {directory + "Gamma1" + dir}, false, name_dos);
       Gamma2D(NRandom, NDisorder, {NMoments,NMoments}, process_string(dirc2), directory + "Gamma2" + dir);
     }
 }
@@ -10,7 +10,9 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
 #include "Global.hpp"
+#include "Diagnostics.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
@@ -27,6 +29,7 @@ class KPM_Vector;
 template <typename T,unsigned D>
 void Simulation<T,D>::store_MU(Eigen::Array<T, -1, -1> *gamma){
     debug_message("Entered store_mu\n");
+    ScopedTimer timer(Diagnostics::STORE);
 
     long int nMoments   = gamma->rows();
     long int nPositions = gamma->cols();
@@ -60,19 +63,26 @@ void Simulation<T,D>::calc_DOS(){
     // This barrier is essential
 #pragma omp barrier
 
-  int NMoments, NRandom, NDisorder;
+  int NMoments, NRandom, NDisorder, Doubling = 0, PDOS = 0;
   bool local_calculate_dos = false;
 #pragma omp master
 {
-  H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+  H5::H5File * file = Config::open(name);
   Global.calculate_dos = false;
   try{
     int dummy_variable;
     get_hdf5<int>(&dummy_variable,  file, (char *)   "/Calculation/dos/NumMoments");
     Global.calculate_dos = true;
   } catch(H5::Exception& e) {debug_message("DOS: no need to calculate DOS.\n");}
-  file->close();
-  delete file;
+
+  // The moments may have been obtained already by a conductivity calculation
+  try{
+    H5::Exception::dontPrint();
+    int harvested = 0;
+    get_hdf5<int>(&harvested, file, (char *) "/Calculation/dos/Harvested");
+    if(harvested)
+      Global.calculate_dos = false;
+  } catch(H5::Exception& e) {}
 }
 #pragma omp barrier
 #pragma omp critical
@@ -88,14 +98,33 @@ if(local_calculate_dos){
 #pragma omp barrier
 #pragma omp critical
 {
-    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
 
     debug_message("DOS: checking if we need to calculate DOS.\n");
     get_hdf5<int>(&NMoments,  file, (char *)   "/Calculation/dos/NumMoments");
     get_hdf5<int>(&NDisorder, file, (char *)   "/Calculation/dos/NumDisorder");
     get_hdf5<int>(&NRandom,   file, (char *)   "/Calculation/dos/NumRandoms");
-    file->close();
-    delete file;
+
+    // Optionally obtain the moments from the doubling identities
+    try{
+      H5::Exception::dontPrint();
+      get_hdf5<int>(&Doubling, file, (char *)   "/Calculation/dos/Doubling");
+    } catch(H5::Exception& e) {}
+
+    // Optionally split the moments by orbital, for the projected DOS
+    try{
+      H5::Exception::dontPrint();
+      get_hdf5<int>(&PDOS, file, (char *)   "/Calculation/dos/PDOS");
+    } catch(H5::Exception& e) {}
+
+    // Optional: stop the sampling at a target error or after a time budget
+    read_sampling(file, "/Calculation/dos/");
+
+    // Optional: split every random vector into probing vectors, one for each colour
+    NRandom *= read_probing(file, "/Calculation/dos/");
+
+    // Optional: keep the recursions for a later run, or continue those of an earlier run
+    read_resume(file, "/Calculation/dos/", "/Calculation/dos/MU");
 
     if(NDisorder <= 0){
       std::cout << "Cannot calculate Density of states with nonpositive NDisorder\n";
@@ -112,16 +141,22 @@ if(local_calculate_dos){
 
 }
 #pragma omp barrier
-  DOS(NMoments, NRandom, NDisorder);
+  if(resume.extend)
+    extend_Gamma1D(NMoments, "/Calculation/dos/MU");
+  else
+    DOS(NMoments, NRandom, NDisorder, Doubling, PDOS);
+  sampler = Sampler<T>();
+  probing = Probing();
+  resume = Resume<T>();
   }
 
 }
 template <typename T,unsigned D>
 
-void Simulation<T,D>::DOS(int NMoments, int NRandom, int NDisorder){
+void Simulation<T,D>::DOS(int NMoments, int NRandom, int NDisorder, int doubling, int pdos){
   debug_message("Entered Simulation::DOS\n");
   std::vector<std::vector<unsigned>> indices = process_string("");
-  Gamma1D(NRandom, NDisorder, NMoments, indices, "/Calculation/dos/MU");
+  Gamma1D(NRandom, NDisorder, NMoments, indices, "/Calculation/dos/MU", doubling, pdos);
   debug_message("Left Simulation::DOS\n");
 }
 
@@ -0,0 +1,120 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Config.hpp"
+#include "Global.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+template <typename T, unsigned D>
+class Hamiltonian;
+template <typename T, unsigned D>
+class KPM_Vector;
+#include "Simulation.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+
+template <typename T,unsigned D>
+void Simulation<T,D>::calc_gamma(){
+  // Checks if a general Gamma matrix needs to be calculated. Its directions are stored
+  // in /Calculation/gamma/Direction with one code for each character of the string
+  // read by process_string: x, y, z -> 0, 1, 2 and ',' -> -1
+  debug_message("Entered Simulation::calc_gamma\n");
+
+  // Make sure that all the threads are ready before opening any files
+  // Some threads could still be inside the Simulation constructor
+  // This barrier is essential
+#pragma omp barrier
+
+  bool local_calculate_gamma = false;
+#pragma omp master
+  {
+    H5::H5File * file = Config::open(name);
+    Global.calculate_gamma = false;
+    try{
+      int dummy_variable;
+      get_hdf5<int>(&dummy_variable, file, (char *) "/Calculation/gamma/NumRandoms");
+      Global.calculate_gamma = true;
+    } catch(H5::Exception& e) {debug_message("Gamma: no need to calculate Gamma.\n");}
+  }
+#pragma omp barrier
+#pragma omp critical
+  local_calculate_gamma = Global.calculate_gamma;
+
+#pragma omp barrier
+
+  if(local_calculate_gamma){
+#pragma omp master
+    {
+      std::cout << "Calculating a general Gamma matrix.\n";
+    }
+#pragma omp barrier
+
+    int NRandom, NDisorder;
+    std::vector<int> N_moments;
+    std::string direction_string;
+#pragma omp critical
+    {
+      H5::H5File * file = Config::open(name);
+      hsize_t dim_moments[1], dim_direction[1];
+
+      H5::DataSet dataset = file->openDataSet("/Calculation/gamma/NumMoments");
+      dataset.getSpace().getSimpleExtentDims(dim_moments, NULL);
+      dataset = file->openDataSet("/Calculation/gamma/Direction");
+      dataset.getSpace().getSimpleExtentDims(dim_direction, NULL);
+
+      N_moments.resize(dim_moments[0]);
+      std::vector<int> direction(dim_direction[0]);
+      get_hdf5<int>(N_moments.data(), file, (char *) "/Calculation/gamma/NumMoments");
+      if(direction.size() > 0)
+        get_hdf5<int>(direction.data(), file, (char *) "/Calculation/gamma/Direction");
+      get_hdf5<int>(&NRandom, file, (char *)   "/Calculation/gamma/NumRandoms");
+      get_hdf5<int>(&NDisorder, file, (char *) "/Calculation/gamma/NumDisorder");
+
+      // Optional: split every random vector into probing vectors, one for each colour
+      NRandom *= read_probing(file, "/Calculation/gamma/");
+
+
+      const char codes[] = "xyz";
+      for(unsigned i = 0; i < direction.size(); i++)
+        direction_string += direction.at(i) < 0 ? ',' : codes[direction.at(i)];
+    }
+
+    GammaGeneral(NRandom, NDisorder, N_moments, process_string(direction_string), "/Calculation/gamma/Gamma");
+    probing = Probing();
+  }
+  debug_message("Left Simulation::calc_gamma\n");
+}
+
+
+template class Simulation<float ,1u>;
+template class Simulation<double ,1u>;
+template class Simulation<long double ,1u>;
+template class Simulation<std::complex<float> ,1u>;
+template class Simulation<std::complex<double> ,1u>;
+template class Simulation<std::complex<long double> ,1u>;
+
+template class Simulation<float ,3u>;
+template class Simulation<double ,3u>;
+template class Simulation<long double ,3u>;
+template class Simulation<std::complex<float> ,3u>;
+template class Simulation<std::complex<double> ,3u>;
+template class Simulation<std::complex<long double> ,3u>;
+
+template class Simulation<float ,2u>;
+template class Simulation<double ,2u>;
+template class Simulation<long double ,2u>;
+template class Simulation<std::complex<float> ,2u>;
+template class Simulation<std::complex<double> ,2u>;
+template class Simulation<std::complex<long double> ,2u>;
@@ -9,6 +9,7 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
 #include "Global.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
@@ -41,14 +42,12 @@ void Simulation<T, DIM>::calc_wavepacket(){
 #pragma omp master
     {
         Global.calculate_wavepacket = 0;
-        H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+        H5::H5File * file = Config::open(name);
       try{
         int dummy_var;
         get_hdf5<int>(&dummy_var, file, (char *) "/Calculation/gaussian_wave_packet/NumDisorder");
         Global.calculate_wavepacket = 1;
       } catch(H5::Exception& e) {debug_message("Wavepacket: no need to calculate.\n");}
-        file->close();  
-        delete file;
     }
 #pragma omp barrier
 #pragma omp critical
@@ -110,7 +109,7 @@ void Simulation<T,D>::Gaussian_Wave_Packet(){
   //Load bra and ket
 #pragma omp critical
   {
-    H5::H5File * file  = new H5::H5File(name, H5F_ACC_RDONLY);
+    H5::H5File * file = Config::open(name);
     dataset            = new H5::DataSet(file->openDataSet("/Calculation/gaussian_wave_packet/k_vector")  );
     dataspace          = new H5::DataSpace(dataset->getSpace());
     dataspace -> getSimpleExtentDims(dim, NULL);
@@ -129,7 +128,6 @@ void Simulation<T,D>::Gaussian_Wave_Packet(){
     get_hdf5     <double>(vb.data(),   file, (char *) "/Calculation/gaussian_wave_packet/mean_value");
     get_hdf5 <double>(k_vector.data(), file, (char *) "/Calculation/gaussian_wave_packet/k_vector");
 
-    file->close();  delete file;
   }
 #pragma omp barrier
   avg_x       = Eigen::Matrix<T,-1,-1>::Zero(NumPoints,1);
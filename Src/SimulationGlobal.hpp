@@ -15,8 +15,12 @@ private:
   // Regular quantities to calculate, such as DOS and CondXX
   Eigen::Array<double, -1, 1> singleshot_energies;
   double EnergyScale;
+  // Times of the phases of each thread, in the order of the teams
+  std::vector<Diagnostics> diagnostics;
 public:
-  GlobalSimulation( char *);
+  GlobalSimulation( char *, bool autotune = false);
+  void run_teams(char *, int);
+  void run_ensemble(char *, int);
 };
 
 
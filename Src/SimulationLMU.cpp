@@ -10,7 +10,9 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
 #include "Global.hpp"
+#include "Diagnostics.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
@@ -27,6 +29,7 @@ class KPM_Vector;
 template <typename T,unsigned D>
 void Simulation<T,D>::store_LMU(Eigen::Array<T, -1, -1> *gamma){
     debug_message("Entered store_lmu\n");
+    ScopedTimer timer(Diagnostics::STORE);
 
     long int nMoments   = gamma->rows();
     long int nPositions = gamma->cols();
@@ -43,26 +46,31 @@ void Simulation<T,D>::store_LMU(Eigen::Array<T, -1, -1> *gamma){
 {
     //std::cout << "Printing huge matrix, brb\n";
     //std::cout << Global.general_gamma << "\n";
-    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
-    write_hdf5(Global.general_gamma, file, "/Calculation/ldos/lMU");
-    file->close();
-    delete file;
+    if(job.parts > 1)
+      store_part(Global.general_gamma, "/Calculation/ldos/lMU");
+    else{
+      H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+      write_hdf5(Global.general_gamma, file, "/Calculation/ldos/lMU");
+      file->close();
+      delete file;
+    }
 }
 #pragma omp barrier    
     debug_message("Left store_lmu\n");
   }
 
 template <typename T,unsigned D>
-void Simulation<T,D>::LMU(int NDisorder, int NMoments, Eigen::Array<unsigned long, -1, 1> positions){
+void Simulation<T,D>::LMU(int NDisorder, int NMoments, Eigen::Array<unsigned long, -1, 1> positions, int doubling){
     debug_message("Entered Simulation::MU\n");
 
     typedef typename extract_value_type<T>::value_type value_type;
-    Eigen::Matrix<T, 1, 2> tmp;
+    Eigen::Matrix<T, -1, -1> tmp;
     int NPositions = positions.size();
     unsigned long pos;
 
     KPM_Vector<T,D> kpm0(1, *this);      // initial random vector
     KPM_Vector<T,D> kpm1(2, *this); // left vector that will be Chebyshev-iterated on
+    Eigen::Matrix<T, -1, -1> kpm0_interior(r.Size, 1); // kpm0 without the ghosts
 
     // initialize the local gamma matrix and set it to 0
     Eigen::Array<T, -1, -1> gamma = Eigen::Array<T, -1, -1 >::Zero(NMoments, NPositions);
@@ -71,7 +79,15 @@ void Simulation<T,D>::LMU(int NDisorder, int NMoments, Eigen::Array<unsigned lon
     Eigen::Array<long, -1, 1> average;
     average = Eigen::Array<long, -1, 1>::Zero(NPositions,1);
 
+    // Only the recursions without doubling can be extended
+    if(resume.save && doubling){
+        verbose_message("LMU: only the recursions without doubling can be extended. Ignoring.\n");
+        resume.save = false;
+    }
+
+    progress_start("/Calculation/ldos/lMU", long(NDisorder)*NPositions);
     for(int disorder = 0; disorder < NDisorder; disorder++){
+        seed_disorder(disorder);
         h.generate_disorder();
 
         for(int pos_index = 0; pos_index < NPositions; pos_index++){
@@ -86,24 +102,42 @@ void Simulation<T,D>::LMU(int NDisorder, int NMoments, Eigen::Array<unsigned lon
 
             kpm1.set_index(0);
             kpm1.v.col(0) = kpm0.v.col(0);
-            kpm0.empty_ghosts(0);
+            gather_interior(&kpm0, kpm0_interior, 0);
+
+            if(doubling){
+                Eigen::Matrix<T, -1, 1> mu;
+                doubling_moments(&kpm1, NMoments, mu);
+                gamma.matrix().col(pos_index) += (mu - gamma.matrix().col(pos_index))/value_type(average(pos_index) + 1);
+                average(pos_index)++;
+                progress_sample();
+                continue;
+            }
 
             for(int n = 0; n < NMoments; n+=2){
                 for(int i = n; i < n+2; i++)
                     if(i!=0) cheb_iteration(&kpm1, i-1);
 
               
-                tmp.setZero();
-                for(std::size_t ii = 0; ii < r.Sized ; ii += r.Ld[0])
-                    tmp += kpm0.v.block(ii,0, r.Ld[0], 1).adjoint() * kpm1.v.block(ii, 0, r.Ld[0], 2);
+                contract(kpm0_interior, &kpm1, tmp);
 
                 gamma(n, pos_index) += (tmp(0,0) - gamma(n, pos_index))/value_type(average(pos_index) + 1);			
                 gamma(n+1, pos_index) += (tmp(0,1) - gamma(n+1, pos_index))/value_type(average(pos_index) + 1);			
             }
             average(pos_index)++;
+            progress_sample();
+
+            // The last two vectors of the recursion
+            if(resume.save){
+                keep_vector(&kpm1, 1 - kpm1.get_index());
+                keep_vector(&kpm1, kpm1.get_index());
+            }
         } 
     }
+    progress_finish();
     store_LMU(&gamma);
+    store_weight("/Calculation/ldos/lMU", NDisorder);
+    if(resume.save)
+        store_resume("/Calculation/ldos/lMU", NMoments, NPositions);
     debug_message("Left Simulation::MU\n");
 }
 
@@ -121,7 +155,7 @@ void Simulation<T,D>::calc_LDOS(){
 #pragma omp master
   {
         Global.calculate_ldos = false;
-        H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+        H5::H5File * file = Config::open(name);
         try{
           int dummy_var;
           get_hdf5<int>(&dummy_var, file, (char *) "/Calculation/ldos/NumDisorder");
@@ -129,14 +163,13 @@ void Simulation<T,D>::calc_LDOS(){
         } catch(H5::Exception& e) {
           debug_message("ldos: no need to calculate.\n");
         }
-          file->close();  
-          delete file;
   }
 #pragma omp barrier
         
         // Now calculate it
           unsigned ldos_NumMoments;
           unsigned ldos_NumDisorder;
+          int ldos_Doubling = 0;
           Eigen::Array<unsigned long, -1, 1> ldos_Orbitals;
           Eigen::Array<unsigned long, -1, 1> ldos_Positions;
 
@@ -154,7 +187,7 @@ void Simulation<T,D>::calc_LDOS(){
           H5::DataSet * dataset;
           H5::DataSpace * dataspace;
           hsize_t dim[1];
-          H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+          H5::H5File * file = Config::open(name);
           dataset            = new H5::DataSet(file->openDataSet("/Calculation/ldos/Orbitals")  );
           dataspace          = new H5::DataSpace(dataset->getSpace());
           dataspace -> getSimpleExtentDims(dim, NULL);
@@ -168,8 +201,16 @@ void Simulation<T,D>::calc_LDOS(){
           get_hdf5<unsigned>(&ldos_NumDisorder, file, (char *) "/Calculation/ldos/NumDisorder");
           get_hdf5<unsigned long>(ldos_Orbitals.data(), file, (char *) "/Calculation/ldos/Orbitals");
           get_hdf5<unsigned long>(ldos_Positions.data(), file, (char *) "/Calculation/ldos/FixPosition");
-          file->close();  
-          delete file;
+          try{
+            H5::Exception::dontPrint();
+            get_hdf5<int>(&ldos_Doubling, file, (char *) "/Calculation/ldos/Doubling");
+          } catch(H5::Exception& e) {}
+
+          // Optional: one probing vector for each colour instead of one vector for each position
+          read_probing(file, "/Calculation/ldos/");
+
+          // Optional: keep the recursions for a later run, or continue those of an earlier run
+          read_resume(file, "/Calculation/ldos/", "/Calculation/ldos/lMU");
   }
 #pragma omp barrier
 
@@ -178,7 +219,30 @@ void Simulation<T,D>::calc_LDOS(){
           
           Eigen::Array<unsigned long, -1, 1> total_positions;
           total_positions = ldos_Positions + ldos_Orbitals*r.Lt[0]*r.Lt[1];
-          LMU(ldos_NumDisorder, ldos_NumMoments, total_positions);
+
+          // With several teams, each one has a part of the positions. The kept recursions
+          // belong to all the positions, so the first team does them all
+          if(job.parts > 1 && (resume.save || resume.extend)){
+            if(job.part == 0)
+              job.parts = 1;
+            else
+              total_positions.resize(0);
+          }
+          if(job.parts > 1){
+            long size = job_share(total_positions.size());
+            total_positions = total_positions.segment(job.first, size).eval();
+          }
+
+          if(total_positions.size() == 0)
+            ;
+          else if(resume.extend)
+            extend_LMU(ldos_NumMoments, total_positions);
+          else if(probing.colours > 1)
+            LMU_probing(ldos_NumDisorder, ldos_NumMoments, total_positions);
+          else
+            LMU(ldos_NumDisorder, ldos_NumMoments, total_positions, ldos_Doubling);
+          probing = Probing();
+          resume = Resume<T>();
         }
     
 
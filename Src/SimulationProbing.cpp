@@ -0,0 +1,201 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Global.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+template <typename T, unsigned D>
+class Hamiltonian;
+template <typename T, unsigned D>
+class KPM_Vector;
+#include "Simulation.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+#include <unordered_map>
+
+template <typename T,unsigned D>
+int Simulation<T,D>::probing_colour(std::size_t * coord){
+  // Colour of the site with global coordinates coord (the last one is the orbital)
+  int colour = probing.dilution ? coord[D] : 0;
+  for(int d = D - 1; d >= 0; d--)
+    colour = colour*probing.period + coord[d]%probing.period;
+  return colour;
+}
+
+
+template <typename T,unsigned D>
+int Simulation<T,D>::read_probing(H5::H5File * file, std::string group){
+  // Reads the optional probing estimators of a calculation and returns the number of
+  // colours. Each random vector is split into one vector for each colour, so the number
+  // of random vectors of the calculation has to be multiplied by it. The estimator is
+  // unbiased for any partition. Its variance only comes from pairs of sites with the same
+  // colour, which the period keeps far apart, where T_n(H) has decayed
+  int period = 1, dilution = 0;
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&period, file, (char *) (group + "Probing").c_str());
+  } catch(H5::Exception& e) {}
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&dilution, file, (char *) (group + "Dilution").c_str());
+  } catch(H5::Exception& e) {}
+
+  probing = Probing();
+  probing.period = std::max(1, period);
+  probing.dilution = dilution;
+  probing.colours = dilution ? r.Orb : 1;
+  for(unsigned d = 0; d < D; d++)
+    probing.colours *= probing.period;
+
+  if(probing.colours > 1){
+    probing.colour = Eigen::Array<int, -1, 1>::Constant(r.Sized, -1);
+    Coordinates<std::size_t, D + 1> local(r.Ld), global(r.Lt);
+    for(std::size_t i = 0; i < r.Sized; i++){
+      local.set_coord(i);
+      bool interior = true;
+      for(unsigned d = 0; d < D; d++)
+        interior = interior && local.coord[d] >= NGHOSTS && local.coord[d] < r.Ld[d] - NGHOSTS;
+      if(interior){
+        r.convertCoordinates(global, local);
+        probing.colour(i) = probing_colour(global.coord);
+      }
+    }
+  }
+  return probing.colours;
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::mask_vector(KPM_Vector<T,D>* kpm, int colour, value_type scale){
+  // Keeps the sites of the given colour, multiplied by scale, and sets the others to zero
+  auto column = kpm->v.col(kpm->get_index());
+  for(std::size_t i = 0; i < r.Sized; i++)
+    column(i) = probing.colour(i) == colour ? column(i)*scale : T(0);
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::probe_vector(KPM_Vector<T,D>* kpm){
+  // Restricts a new random vector to the next colour. The factor sqrt(colours) makes the
+  // average over the colours the sum of their traces, so the random vectors can be averaged
+  // as usual, as long as their number is a multiple of the number of colours
+  if(probing.colours <= 1)
+    return;
+  int colour = probing.next % probing.colours;
+  probing.next++;
+  mask_vector(kpm, colour, std::sqrt(value_type(probing.colours)));
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::LMU_probing(int NDisorder, int NMoments, Eigen::Array<unsigned long, -1, 1> positions){
+  // Local moments of all the positions with one vector for each colour, instead of one
+  // vector for each position. |r> has random phases on the sites of colour c, so for a
+  // site i of that colour
+  //   conj(r_i)<i|T_n|r>/|r_i|^2 = <i|T_n|i> + sum_j conj(r_i) r_j <i|T_n|j>/|r_i|^2
+  // where j are the other sites of colour c. These are at least a period away, where
+  // T_n(H) has decayed, and their contribution averages to zero over the realisations
+  debug_message("Entered Simulation::LMU_probing\n");
+  if(resume.save){
+    verbose_message("LDoS: the probing vectors cannot be extended. Ignoring SaveVectors.\n");
+    resume.save = false;
+  }
+  int NPositions = positions.size();
+
+  // Colour of each position and its index in this thread, -1 if it is in another thread
+  std::vector<int>  pos_colour(NPositions);
+  std::vector<long> pos_local(NPositions, -1);
+  std::unordered_map<std::size_t, std::vector<int>> lookup;
+  Coordinates<std::size_t, D + 1> local(r.Ld), global(r.Lt);
+  for(int p = 0; p < NPositions; p++){
+    global.set_coord(positions(p));
+    pos_colour.at(p) = probing_colour(global.coord);
+    lookup[positions(p)].push_back(p);
+  }
+  for(std::size_t i = 0; i < r.Sized; i++)
+    if(probing.colour(i) >= 0){
+      local.set_coord(i);
+      r.convertCoordinates(global, local);
+      auto found = lookup.find(global.index);
+      if(found != lookup.end())
+        for(int p : found->second)
+          pos_local.at(p) = i;
+    }
+  std::vector<int> used(pos_colour);
+  std::sort(used.begin(), used.end());
+  used.erase(std::unique(used.begin(), used.end()), used.end());
+  verbose_message("LDoS: " << used.size() << " probing vectors for " << NPositions << " positions.\n");
+
+  KPM_Vector<T,D> kpm0(1, *this);      // probing vector
+  KPM_Vector<T,D> kpm1(2, *this);      // vector that will be Chebyshev-iterated on
+  Eigen::Array<T, -1, -1> gamma = Eigen::Array<T, -1, -1 >::Zero(NMoments, NPositions);
+
+  long average = 0;
+  progress_start("/Calculation/ldos/lMU", long(NDisorder)*used.size());
+  for(int disorder = 0; disorder < NDisorder; disorder++){
+    h.generate_disorder();
+
+    for(int colour : used){
+      kpm0.initiate_vector();
+      mask_vector(&kpm0, colour, 1);
+      kpm0.Exchange_Boundaries();
+      kpm1.set_index(0);
+      kpm1.v.col(0) = kpm0.v.col(0);
+
+      std::vector<int> mine;
+      for(int p = 0; p < NPositions; p++)
+        if(pos_colour.at(p) == colour && pos_local.at(p) >= 0)
+          mine.push_back(p);
+
+      for(int n = 0; n < NMoments; n++){
+        if(n != 0) cheb_iteration(&kpm1, n - 1);
+        for(int p : mine){
+          T ri = kpm0.v(pos_local.at(p), 0);
+          value_type norm = std::real(myconj(ri)*ri);
+          if(norm > 0)
+            gamma(n, p) += (myconj(ri)*kpm1.v(pos_local.at(p), kpm1.get_index())/norm - gamma(n, p))/value_type(average + 1);
+        }
+      }
+      progress_sample();
+    }
+    average++;
+  }
+  progress_finish();
+  store_LMU(&gamma);
+  store_weight("/Calculation/ldos/lMU", average);
+  debug_message("Left Simulation::LMU_probing\n");
+}
+
+
+template class Simulation<float ,1u>;
+template class Simulation<double ,1u>;
+template class Simulation<long double ,1u>;
+template class Simulation<std::complex<float> ,1u>;
+template class Simulation<std::complex<double> ,1u>;
+template class Simulation<std::complex<long double> ,1u>;
+
+template class Simulation<float ,3u>;
+template class Simulation<double ,3u>;
+template class Simulation<long double ,3u>;
+template class Simulation<std::complex<float> ,3u>;
+template class Simulation<std::complex<double> ,3u>;
+template class Simulation<std::complex<long double> ,3u>;
+
+template class Simulation<float ,2u>;
+template class Simulation<double ,2u>;
+template class Simulation<long double ,2u>;
+template class Simulation<std::complex<float> ,2u>;
+template class Simulation<std::complex<double> ,2u>;
+template class Simulation<std::complex<long double> ,2u>;
@@ -0,0 +1,178 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Global.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+template <typename T, unsigned D>
+class Hamiltonian;
+template <typename T, unsigned D>
+class KPM_Vector;
+#include "Simulation.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+namespace {
+
+// Last status of the calculation of each team, for the JSON file
+std::map<const void*, std::string> statuses;
+
+std::string clock_time(double seconds_from_now){
+  std::time_t t = std::time(NULL) + std::time_t(seconds_from_now);
+  char buffer[32];
+  std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", std::localtime(&t));
+  return buffer;
+}
+
+std::string duration(double seconds){
+  long s = long(seconds);
+  std::ostringstream out;
+  out << s/3600 << ":" << std::setw(2) << std::setfill('0') << (s/60)%60 << ":" << std::setw(2) << s%60;
+  return out.str();
+}
+
+void write_status(const void * team, const std::string & status){
+  // Rewrites the whole file, through a temporary one, so the scheduler never reads half of it
+  char *env = getenv("PROGRESS_FILE");
+  if(env == NULL)
+    return;
+#pragma omp critical (progress)
+  {
+    statuses[team] = status;
+    std::string filename = env;
+    std::ofstream file(filename + ".tmp");
+    file << "{\n  \"time\": \"" << clock_time(0) << "\",\n  \"calculations\": [";
+    bool first = true;
+    for(auto & entry : statuses){
+      file << (first ? "\n    " : ",\n    ") << entry.second;
+      first = false;
+    }
+    file << "\n  ]\n}\n";
+    file.close();
+    std::rename((filename + ".tmp").c_str(), filename.c_str());
+  }
+}
+
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::progress_start(std::string name_dataset, long samples){
+  // Called by all the threads before the loops over the samples
+  if(progress.interval <= 0)
+    return;
+  progress.name_dataset = name_dataset;
+  progress.samples = samples;
+  progress.done = 0;
+  progress.products = 0;
+  progress.per_sample = 0;
+  progress.motor = 0;
+  // Each product reads two vectors and writes one, in every thread
+  progress.bytes = 3.0*sizeof(T)*r.Sized*r.n_threads;
+  progress.start = progress.last = std::chrono::steady_clock::now();
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::progress_sample(){
+  if(progress.interval <= 0)
+    return;
+  progress.done++;
+  if(progress.done == 1)
+    progress.per_sample = progress.products;
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::progress_report(bool finished){
+  auto now = std::chrono::steady_clock::now();
+  progress.last = now;
+  double elapsed = std::chrono::duration<double>(now - progress.start).count();
+  double rate = (elapsed > 0) ? progress.products/elapsed : 0;
+  double bandwidth = (progress.motor > 0) ? progress.products*progress.bytes/progress.motor/1e9 : 0;
+
+  // Unknown until the first sample is finished
+  double fraction = -1;
+  if(finished)
+    fraction = 1;
+  else if(progress.per_sample > 0)
+    fraction = std::min(1.0, double(progress.products)/(double(progress.per_sample)*progress.samples));
+  double remaining = (fraction > 0) ? elapsed*(1 - fraction)/fraction : -1;
+
+  std::ostringstream line;
+  line << std::fixed << "Progress of " << progress.name_dataset << ": ";
+  if(fraction >= 0)
+    line << std::setprecision(1) << 100*fraction << "% ";
+  line << "(" << progress.done << "/" << progress.samples << " samples), " << std::setprecision(0)
+       << rate << " moments/s, " << std::setprecision(2) << bandwidth << " GB/s in the products, ";
+  if(finished)
+    line << "finished in " << duration(elapsed) << ".\n";
+  else if(remaining >= 0)
+    line << "finishes in " << duration(remaining) << " at " << clock_time(remaining) << ".\n";
+  else
+    line << "running for " << duration(elapsed) << ".\n";
+  std::cout << line.str() << std::flush;
+
+  std::ostringstream status;
+  status << std::setprecision(6) << "{\"dataset\": \"" << progress.name_dataset << "\", \"samples\": "
+         << progress.samples << ", \"samples_done\": " << progress.done << ", \"fraction\": ";
+  if(fraction >= 0)
+    status << fraction;
+  else
+    status << "null";
+  status << ", \"moments_per_second\": " << rate << ", \"bandwidth_GBs\": " << bandwidth
+         << ", \"elapsed\": " << elapsed << ", \"remaining\": ";
+  if(remaining >= 0)
+    status << remaining << ", \"finish_time\": \"" << clock_time(remaining) << "\"";
+  else
+    status << "null, \"finish_time\": null";
+  status << ", \"finished\": " << (finished ? "true" : "false") << "}";
+  write_status(&progress, status.str());
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::progress_finish(){
+  if(progress.interval <= 0 || progress.samples <= 0)
+    return;
+  progress_report(true);
+  progress.samples = 0;
+}
+
+
+template class Simulation<float ,1u>;
+template class Simulation<double ,1u>;
+template class Simulation<long double ,1u>;
+template class Simulation<std::complex<float> ,1u>;
+template class Simulation<std::complex<double> ,1u>;
+template class Simulation<std::complex<long double> ,1u>;
+
+template class Simulation<float ,3u>;
+template class Simulation<double ,3u>;
+template class Simulation<long double ,3u>;
+template class Simulation<std::complex<float> ,3u>;
+template class Simulation<std::complex<double> ,3u>;
+template class Simulation<std::complex<long double> ,3u>;
+
+template class Simulation<float ,2u>;
+template class Simulation<double ,2u>;
+template class Simulation<long double ,2u>;
+template class Simulation<std::complex<float> ,2u>;
+template class Simulation<std::complex<double> ,2u>;
+template class Simulation<std::complex<long double> ,2u>;
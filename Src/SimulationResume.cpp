@@ -0,0 +1,289 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Global.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+template <typename T, unsigned D>
+class Hamiltonian;
+template <typename T, unsigned D>
+class KPM_Vector;
+#include "Simulation.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+
+template <typename T,unsigned D>
+void Simulation<T,D>::read_resume(H5::H5File * file, std::string group, std::string name_dataset){
+  // Reads the optional SaveVectors and Extend of a calculation. The recursions are kept in
+  // name_dataset + "Resume", with one dataset of vectors and one seed for each thread.
+  // With Extend, this thread reads back the recursions that it kept in the earlier run
+  int save = 0, extend = 0;
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&save, file, (char *) (group + "SaveVectors").c_str());
+  } catch(H5::Exception& e) {}
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&extend, file, (char *) (group + "Extend").c_str());
+  } catch(H5::Exception& e) {}
+
+  resume = Resume<T>();
+  resume.save = save || extend;
+  resume.extend = extend;
+  if(resume.save && !resume.extend)
+    resume.seed = unsigned(h.rnd.get()*INT_MAX);
+  if(!resume.extend)
+    return;
+
+  std::string dir = name_dataset + "Resume/";
+  std::string id = std::to_string(r.thread_id);
+  int seed = 0;
+  hsize_t dim[2] = {0, 0};
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&resume.moments, file, (char *) (dir + "NumMoments").c_str());
+    get_hdf5<int>(&resume.per_disorder, file, (char *) (dir + "PerDisorder").c_str());
+    get_hdf5<int>(&seed, file, (char *) (dir + "Seed" + id).c_str());
+    H5::DataSet dataset = file->openDataSet(dir + "Vectors" + id);
+    dataset.getSpace().getSimpleExtentDims(dim, NULL);
+  } catch(H5::Exception& e) {
+    std::cout << "Cannot extend " << name_dataset << ": the file has no recursions of an earlier run"
+      " with SaveVectors and the same number of threads. Exiting.\n";
+    exit(0);
+  }
+  if(dim[1] != r.Sized){
+    std::cout << "Cannot extend " << name_dataset << ": the recursions were kept with a different"
+      " domain decomposition. Exiting.\n";
+    exit(0);
+  }
+
+  resume.seed = seed;
+  Eigen::Matrix<T, -1, -1> vectors(r.Sized, dim[0]);
+  get_hdf5<T>(vectors.data(), file, (char *) (dir + "Vectors" + id).c_str());
+  for(hsize_t c = 0; c < dim[0]; c++)
+    resume.vectors.push_back(vectors.col(c));
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::seed_disorder(int disorder){
+  // Makes disorder realisation number disorder reproducible when the recursions are kept
+  if(resume.save)
+    h.rnd.seed(resume.seed + disorder);
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::keep_vector(KPM_Vector<T,D>* kpm, int col){
+  resume.vectors.push_back(kpm->v.col(col));
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::store_resume(std::string name_dataset, int moments, int per_disorder){
+  // Writes the kept recursions next to name_dataset, replacing those of an earlier run.
+  // The threads write their own vectors one at a time
+  std::string dir = name_dataset + "Resume/";
+#pragma omp master
+  {
+    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+    try{
+      H5::Exception::dontPrint();
+      file->unlink(name_dataset + "Resume");
+    } catch(H5::Exception& e) {}
+    file->createGroup(name_dataset + "Resume");
+    Eigen::Array<int, -1, -1> value = Eigen::Array<int, -1, -1>::Constant(1, 1, moments);
+    write_hdf5(value, file, dir + "NumMoments");
+    value(0) = per_disorder;
+    write_hdf5(value, file, dir + "PerDisorder");
+    delete file;
+  }
+#pragma omp barrier
+#pragma omp critical
+  {
+    std::string id = std::to_string(r.thread_id);
+    Eigen::Array<T, -1, -1> vectors(r.Sized, resume.vectors.size());
+    for(unsigned c = 0; c < resume.vectors.size(); c++)
+      vectors.col(c) = resume.vectors.at(c);
+    Eigen::Array<int, -1, -1> seed = Eigen::Array<int, -1, -1>::Constant(1, 1, resume.seed);
+
+    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+    write_hdf5(vectors, file, dir + "Vectors" + id);
+    write_hdf5(seed, file, dir + "Seed" + id);
+    delete file;
+  }
+#pragma omp barrier
+}
+
+
+// The moments of the earlier run have to match the kept recursions
+static void check_extent(H5::H5File * file, std::string name_dataset, long size){
+  hsize_t dim[2] = {0, 0};
+  file->openDataSet(name_dataset).getSpace().getSimpleExtentDims(dim, NULL);
+  if(long(dim[0]*dim[1]) != size){
+    std::cout << "Cannot extend " << name_dataset << ": it does not have the moments of the kept"
+      " recursions. Exiting.\n";
+    exit(0);
+  }
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::extend_Gamma1D(int N_moments, std::string name_dataset){
+  // Continues the recursions of the DOS kept by an earlier run up to N_moments moments. Each
+  // one restarts from T_{N-2}|r> and T_{N-1}|r>, in the same disorder realisation, so only the
+  // new moments cost multiplications. The earlier moments are read back from name_dataset
+  debug_message("Entered Simulation::extend_Gamma1D\n");
+  const int done = resume.moments;
+  const long count = resume.vectors.size()/3;
+  if(N_moments <= done){
+    verbose_message("Extend: " << name_dataset << " already has " << done << " moments.\n");
+    return;
+  }
+
+  KPM_Vector<T,D> kpm0(1, *this);
+  KPM_Vector<T,D> kpm1(2, *this);
+  Eigen::Array<T, -1, -1> gamma = Eigen::Array<T, -1, -1 >::Zero(1, N_moments);
+  Eigen::Matrix<T, -1, -1> tmp;
+  Eigen::Matrix<T, -1, -1> kpm0_interior(r.Size, 1);
+
+  for(long k = 0; k < count; k++){
+    if(k % resume.per_disorder == 0){
+      seed_disorder(k/resume.per_disorder);
+      h.generate_disorder();
+    }
+
+    kpm0.set_index(0);
+    kpm0.v.col(0) = resume.vectors.at(3*k);
+    kpm1.v.col(0) = resume.vectors.at(3*k + 1);
+    kpm1.v.col(1) = resume.vectors.at(3*k + 2);
+    kpm1.set_index(1);
+    gather_interior(&kpm0, kpm0_interior, 0);
+
+    for(int m = done; m < N_moments; m += 2){
+      kpm1.template Multiply<1>();
+      kpm1.template Multiply<1>();
+      contract(kpm0_interior, &kpm1, tmp);
+      gamma.matrix().block(0, m, 1, 2) += (tmp - gamma.matrix().block(0, m, 1, 2))/value_type(k + 1);
+    }
+    resume.vectors.at(3*k + 1) = kpm1.v.col(1 - kpm1.get_index());
+    resume.vectors.at(3*k + 2) = kpm1.v.col(kpm1.get_index());
+  }
+
+  // The master adds the earlier moments, which are already the sum over the threads
+#pragma omp master
+  {
+    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+    Eigen::Array<T, -1, -1> earlier(1, done);
+    check_extent(file, name_dataset, earlier.size());
+    get_hdf5<T>(earlier.data(), file, (char *) name_dataset.c_str());
+    gamma.block(0, 0, 1, done) = earlier;
+    file->unlink(name_dataset);
+    delete file;
+  }
+#pragma omp barrier
+  store_gamma1D(&gamma, name_dataset);
+  store_weight(name_dataset, count);
+  store_resume(name_dataset, N_moments, resume.per_disorder);
+  debug_message("Left Simulation::extend_Gamma1D\n");
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::extend_LMU(int NMoments, Eigen::Array<unsigned long, -1, 1> positions){
+  // Same as extend_Gamma1D for the local moments, where the starting vectors are the sites
+  debug_message("Entered Simulation::extend_LMU\n");
+  const std::string name_dataset = "/Calculation/ldos/lMU";
+  const int done = resume.moments;
+  const int NPositions = positions.size();
+  const long count = resume.vectors.size()/2;
+  if(NMoments <= done){
+    verbose_message("Extend: " << name_dataset << " already has " << done << " moments.\n");
+    return;
+  }
+  if(resume.per_disorder != NPositions){
+    std::cout << "Cannot extend " << name_dataset << " with different positions. Exiting.\n";
+    exit(0);
+  }
+
+  KPM_Vector<T,D> kpm0(1, *this);
+  KPM_Vector<T,D> kpm1(2, *this);
+  Eigen::Matrix<T, -1, -1> tmp;
+  Eigen::Matrix<T, -1, -1> kpm0_interior(r.Size, 1);
+  Eigen::Array<T, -1, -1> gamma = Eigen::Array<T, -1, -1 >::Zero(NMoments, NPositions);
+
+  for(long k = 0; k < count; k++){
+    int pos_index = k % NPositions;
+    if(pos_index == 0){
+      seed_disorder(k/NPositions);
+      h.generate_disorder();
+    }
+
+    kpm0.build_site(positions(pos_index));
+    gather_interior(&kpm0, kpm0_interior, 0);
+    kpm1.v.col(0) = resume.vectors.at(2*k);
+    kpm1.v.col(1) = resume.vectors.at(2*k + 1);
+    kpm1.set_index(1);
+
+    for(int n = done; n < NMoments; n += 2){
+      for(int i = n; i < n + 2; i++)
+        cheb_iteration(&kpm1, i - 1);
+      contract(kpm0_interior, &kpm1, tmp);
+      long average = k/NPositions;
+      gamma(n, pos_index) += (tmp(0,0) - gamma(n, pos_index))/value_type(average + 1);
+      gamma(n + 1, pos_index) += (tmp(0,1) - gamma(n + 1, pos_index))/value_type(average + 1);
+    }
+    resume.vectors.at(2*k) = kpm1.v.col(1 - kpm1.get_index());
+    resume.vectors.at(2*k + 1) = kpm1.v.col(kpm1.get_index());
+  }
+
+#pragma omp master
+  {
+    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+    Eigen::Array<T, -1, -1> earlier(done, NPositions);
+    check_extent(file, name_dataset, earlier.size());
+    get_hdf5<T>(earlier.data(), file, (char *) name_dataset.c_str());
+    gamma.block(0, 0, done, NPositions) = earlier;
+    file->unlink(name_dataset);
+    delete file;
+  }
+#pragma omp barrier
+  store_LMU(&gamma);
+  store_weight(name_dataset, count/NPositions);
+  store_resume(name_dataset, NMoments, NPositions);
+  debug_message("Left Simulation::extend_LMU\n");
+}
+
+
+template class Simulation<float ,1u>;
+template class Simulation<double ,1u>;
+template class Simulation<long double ,1u>;
+template class Simulation<std::complex<float> ,1u>;
+template class Simulation<std::complex<double> ,1u>;
+template class Simulation<std::complex<long double> ,1u>;
+
+template class Simulation<float ,3u>;
+template class Simulation<double ,3u>;
+template class Simulation<long double ,3u>;
+template class Simulation<std::complex<float> ,3u>;
+template class Simulation<std::complex<double> ,3u>;
+template class Simulation<std::complex<long double> ,3u>;
+
+template class Simulation<float ,2u>;
+template class Simulation<double ,2u>;
+template class Simulation<long double ,2u>;
+template class Simulation<std::complex<float> ,2u>;
+template class Simulation<std::complex<double> ,2u>;
+template class Simulation<std::complex<long double> ,2u>;
@@ -0,0 +1,208 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Global.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+template <typename T, unsigned D>
+class Hamiltonian;
+template <typename T, unsigned D>
+class KPM_Vector;
+#include "SampleWriter.hpp"
+#include "Simulation.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+
+template <typename T,unsigned D>
+void Simulation<T,D>::read_sampling(H5::H5File * file, std::string group){
+  // Reads the optional stopping rules of the sampling of a calculation. With them, NumRandoms
+  // and NumDisorder become the maximum numbers of random vectors and disorder realisations.
+  // SaveSamples also writes every sample, for the error analysis of the averages
+  int stream = 0;
+  sampler.tolerance = 0;
+  sampler.budget = 0;
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<double>(&sampler.tolerance, file, (char *) (group + "Tolerance").c_str());
+  } catch(H5::Exception& e) {}
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<double>(&sampler.budget, file, (char *) (group + "TimeBudget").c_str());
+  } catch(H5::Exception& e) {}
+  try{
+    H5::Exception::dontPrint();
+    get_hdf5<int>(&stream, file, (char *) (group + "SaveSamples").c_str());
+  } catch(H5::Exception& e) {}
+  sampler.stream = stream;
+}
+
+
+template <typename T,unsigned D>
+bool Simulation<T,D>::sampling_active(){
+  return sampler.tolerance > 0 || sampler.budget > 0 || sampler.stream;
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::start_sampling(long rows, long cols, std::vector<std::string> name_datasets){
+  // Each column of the samples belongs to one of the datasets. With SaveSamples, the
+  // master streams the samples of column c to name_datasets[c] + "PerSample", one row each
+  sampler.count = 0;
+  sampler.mean = Eigen::Array<T, -1, -1>::Zero(rows, cols);
+  sampler.M2 = Eigen::Array<value_type, -1, -1>::Zero(rows, cols);
+  sampler.start = std::chrono::high_resolution_clock::now();
+
+#pragma omp master
+  if(sampler.stream){
+    for(unsigned c = 0; c < name_datasets.size(); c++)
+      name_datasets.at(c) += "PerSample";
+    sampler.writer = new SampleWriter<T>(name, name_datasets, rows);
+  }
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::finish_sampling(){
+  // Waits for the samples that are still being written. The file is free afterwards
+#pragma omp master
+  {
+    delete sampler.writer;
+    sampler.writer = nullptr;
+  }
+#pragma omp barrier
+}
+
+
+template <typename T,unsigned D>
+double Simulation<T,D>::sampling_error(){
+  // Relative standard error of the mean, |error|/|mean| over all the elements
+  if(sampler.count < 2)
+    return std::numeric_limits<double>::infinity();
+  double variance = double(sampler.M2.sum())/(double(sampler.count - 1)*sampler.count);
+  return std::sqrt(variance)/double(sampler.mean.matrix().norm());
+}
+
+
+template <typename T,unsigned D>
+bool Simulation<T,D>::sample_converged(Eigen::Array<T, -1, -1> & sample){
+  // Adds the part of this thread of the last sample. The master updates the statistics of
+  // the whole sample and decides for all the threads if the sampling is over
+#pragma omp master
+  Global.sample = Eigen::Array<T, -1, -1>::Zero(sample.rows(), sample.cols());
+#pragma omp barrier
+#pragma omp critical
+  Global.sample += sample;
+#pragma omp barrier
+
+#pragma omp master
+  {
+    sampler.count++;
+    if(sampler.writer)
+      sampler.writer->push(Global.sample);
+    Eigen::Array<T, -1, -1> delta = Global.sample - sampler.mean;
+    sampler.mean += delta/value_type(sampler.count);
+    sampler.M2 += (delta.conjugate()*(Global.sample - sampler.mean)).real();
+
+    double error = sampling_error();
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - sampler.start;
+    Global.stop_sampling = (sampler.tolerance > 0 && error < sampler.tolerance) ||
+      (sampler.budget > 0 && elapsed.count() > sampler.budget);
+    if(Global.stop_sampling)
+      std::cout << "Stopped the sampling after " << sampler.count << " samples and " << elapsed.count()
+                << " s, with a relative standard error of " << error << ".\n" << std::flush;
+  }
+#pragma omp barrier
+  return Global.stop_sampling;
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::project_sample(Eigen::Array<T, -1, -1> & sample, int col, long rows, int factor, bool symmetric){
+  // Brings column col of a sample of Gamma2D, already multiplied by factor, to the form in
+  // which store_gamma stores the average. The blocks skipped by the symmetric mode are
+  // recovered, and the matrix is replaced by (G + factor*G^dagger)/2
+  Eigen::Map<Eigen::Matrix<T, -1, -1>> G(sample.col(col).data(), rows, sample.rows()/rows);
+  if(symmetric)
+    for(long m = 0; m < G.cols(); m++)
+      for(long n = 0; n < rows; n++)
+        if(n/MEMORY > m/MEMORY)
+          G(n,m) = T(factor)*myconj(G(m,n));
+  Eigen::Matrix<T, -1, -1> projected = (G + T(factor)*G.adjoint())/value_type(2);
+  G = projected;
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::store_sampling(std::string name_dataset, int col, long rows){
+  // Stores the standard error of column col of the samples, as a matrix with the given
+  // number of rows, and the number of samples that were used
+#pragma omp master
+  {
+    long size = sampler.M2.rows();
+    Eigen::Array<value_type, -1, -1> error = Eigen::Array<value_type, -1, -1>::Zero(rows, size/rows);
+    if(sampler.count > 1)
+      error = Eigen::Map<Eigen::Array<value_type, -1, -1>>(sampler.M2.col(col).data(), rows, size/rows)/
+        value_type(double(sampler.count - 1)*sampler.count);
+    error = error.sqrt();
+    Eigen::Array<int, -1, -1> samples = Eigen::Array<int, -1, -1>::Constant(1, 1, sampler.count);
+
+    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+    write_hdf5(error, file, name_dataset + "Error");
+    write_hdf5(samples, file, name_dataset + "Samples");
+    delete file;
+  }
+#pragma omp barrier
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::store_weight(std::string name_dataset, long weight){
+  // Stores the number of samples (random vectors times disorder realisations) behind the
+  // average in name_dataset. KITEx --merge uses it to combine the averages of several runs
+#pragma omp master
+  {
+    // The teams that share a calculation store the same weight
+#pragma omp critical
+    {
+      Eigen::Array<int, -1, -1> value = Eigen::Array<int, -1, -1>::Constant(1, 1, weight);
+      H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+      write_hdf5(value, file, name_dataset + "Weight");
+      delete file;
+    }
+  }
+#pragma omp barrier
+}
+
+
+template class Simulation<float ,1u>;
+template class Simulation<double ,1u>;
+template class Simulation<long double ,1u>;
+template class Simulation<std::complex<float> ,1u>;
+template class Simulation<std::complex<double> ,1u>;
+template class Simulation<std::complex<long double> ,1u>;
+
+template class Simulation<float ,3u>;
+template class Simulation<double ,3u>;
+template class Simulation<long double ,3u>;
+template class Simulation<std::complex<float> ,3u>;
+template class Simulation<std::complex<double> ,3u>;
+template class Simulation<std::complex<long double> ,3u>;
+
+template class Simulation<float ,2u>;
+template class Simulation<double ,2u>;
+template class Simulation<long double ,2u>;
+template class Simulation<std::complex<float> ,2u>;
+template class Simulation<std::complex<double> ,2u>;
+template class Simulation<std::complex<long double> ,2u>;
@@ -9,6 +9,7 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
 #include "Global.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
@@ -45,7 +46,7 @@ void Simulation<T,D>::calc_singleshot() {
   int calculate_singleshot_local = false;
 #pragma omp master
 {
-  H5::H5File * file1 = new H5::H5File(name, H5F_ACC_RDONLY);
+  H5::H5File * file1 = Config::open(name);
   Global.calculate_singleshot = false;
   try{
     debug_message("single_shot dc checking if we need to calculate it.\n");
@@ -53,8 +54,6 @@ void Simulation<T,D>::calc_singleshot() {
     Global.calculate_singleshot = true;
     
   } catch(H5::Exception& e) {debug_message("singleshot dc: no need to calculate it.\n");}
-  file1->close();
-  delete file1;
   
 }
 #pragma omp barrier
@@ -71,7 +70,7 @@ void Simulation<T,D>::calc_singleshot() {
 #pragma omp barrier
 #pragma omp critical
 {
-      H5::H5File * file = new H5::H5File(name, H5F_ACC_RDONLY);
+      H5::H5File * file = Config::open(name);
     get_hdf5<int>(&direction, file, (char *)   "/Calculation/singleshot_conductivity_dc/Direction");
     get_hdf5<int>(&NRandom, file, (char *)   "/Calculation/singleshot_conductivity_dc/NumRandoms");
     get_hdf5<int>(&NDisorder, file, (char *)   "/Calculation/singleshot_conductivity_dc/NumDisorder");
@@ -124,8 +123,6 @@ void Simulation<T,D>::calc_singleshot() {
     delete dataset_moments;
     get_hdf5<int>(moments.data(),  	file, (char *)   "/Calculation/singleshot_conductivity_dc/NumMoments");
 
-    file->close();
-  delete file;
 }
 
   singleshot(energies, gammas, preserve_disorders, moments, NDisorder, NRandom, direction_string);
@@ -151,10 +148,8 @@ void Simulation<T,D>::singleshot(Eigen::Array<double, -1, 1> energies,
 
 #pragma omp critical
 {
-  H5::H5File * fetchfile         = new H5::H5File(name, H5F_ACC_RDONLY);
+  H5::H5File * fetchfile = Config::open(name);
   get_hdf5<double>(&EnergyScale,  fetchfile, (char *)   "/EnergyScale");
-  fetchfile->close();
-  delete fetchfile;
 }
 #pragma omp barrier
   double EScale = EnergyScale;
@@ -266,7 +261,6 @@ void Simulation<T,D>::singleshot(Eigen::Array<double, -1, 1> energies,
         phi.set_index(0);
         phi.Exchange_Boundaries();
         generalized_velocity(&phi1, &phi, indices, 1);
-        phi1.empty_ghosts(0);
         
           
         phi.set_index(0);			
@@ -281,10 +275,11 @@ void Simulation<T,D>::singleshot(Eigen::Array<double, -1, 1> energies,
         }
           
           
-        // finally, the dot product of phi1 and phi0 yields the conductivity
+        // finally, the dot product of phi1 and phi0 yields the conductivity.
+        // Only the lines of this thread enter, the ghosts are skipped
         tmp *= 0.;
-        for(std::size_t ii = 0; ii < r.Sized ; ii += r.Ld[0])
-          tmp += T(phi1.v.col(0).segment(ii,r.Ld[0]).adjoint() * phi0.v.col(0).segment(ii,r.Ld[0]));
+        for(std::size_t l = 0; l < r.lines.size(); l++)
+          tmp += T(phi1.v.col(0).segment(r.lines[l],r.ld[0]).adjoint() * phi0.v.col(0).segment(r.lines[l],r.ld[0]));
         cond_array(job_index) += (tmp - cond_array(job_index))/value_type(average_R+1);						
         debug_message("Concluded SingleShot calculation for SSPRINT=0\n");
 #elif (SSPRINT != 0)
@@ -323,7 +318,6 @@ void Simulation<T,D>::singleshot(Eigen::Array<double, -1, 1> energies,
           // so the product of phi1 by the velocity is stored in phi2 instead
           phi2.set_index(0);
           generalized_velocity(&phi2, &phi1, indices, 1);
-          phi2.empty_ghosts(0);
           
             
           for(int n = nn*job_NMoments/SSPRINT; n < job_NMoments/SSPRINT*(nn+1); n++){		
@@ -338,8 +332,8 @@ void Simulation<T,D>::singleshot(Eigen::Array<double, -1, 1> energies,
           // until all the moments have been summed. otherwise the result would be wrong
           T temp;
           temp *= 0.;
-          for(std::size_t ii = 0; ii < r.Sized ; ii += r.Ld[0])
-            temp += phi2.v.col(0).segment(ii,r.Ld[0]).adjoint() * phi0.v.col(0).segment(ii,r.Ld[0]);
+          for(std::size_t l = 0; l < r.lines.size(); l++)
+            temp += phi2.v.col(0).segment(r.lines[l],r.ld[0]).adjoint() * phi0.v.col(0).segment(r.lines[l],r.ld[0]);
 
 
           if(nn == SSPRINT-1){
@@ -0,0 +1,93 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Global.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+template <typename T, unsigned D>
+class Hamiltonian;
+template <typename T, unsigned D>
+class KPM_Vector;
+#include "Simulation.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+
+template <typename T,unsigned D>
+long Simulation<T,D>::job_share(long total){
+  // Columns of the part of this team out of total columns. Returns how many there are
+  job.total = total;
+  job.first = total*job.part/job.parts;
+  return total*(job.part + 1)/job.parts - job.first;
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::store_part(Eigen::Array<T, -1, -1> & gamma, std::string name_dataset){
+  // Called by the master of the team. Writes the columns of this part into name_dataset, which
+  // has the columns of all the parts. The first part that is stored creates it
+#pragma omp critical
+  {
+    hsize_t dims[2]   = {hsize_t(job.total), hsize_t(gamma.rows())};
+    hsize_t count[2]  = {hsize_t(gamma.cols()), hsize_t(gamma.rows())};
+    hsize_t offset[2] = {hsize_t(job.first), 0};
+    auto datatype = hdf5_datatype<T>();
+
+    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+    H5::DataSet dataset;
+    bool found = H5Lexists(file->getId(), name_dataset.c_str(), H5P_DEFAULT) > 0;
+    if(found){
+      // An output of an earlier run with other sizes is replaced
+      hsize_t old[2] = {0, 0};
+      dataset = file->openDataSet(name_dataset);
+      dataset.getSpace().getSimpleExtentDims(old, NULL);
+      if(old[0] != dims[0] || old[1] != dims[1]){
+        dataset.close();
+        file->unlink(name_dataset);
+        found = false;
+      }
+    }
+    if(!found)
+      dataset = file->createDataSet(name_dataset, datatype, H5::DataSpace(2, dims));
+
+    H5::DataSpace filespace = dataset.getSpace();
+    filespace.selectHyperslab(H5S_SELECT_SET, count, offset);
+    dataset.write(gamma.data(), datatype, H5::DataSpace(2, count), filespace);
+    dataset.close();
+    file->close();
+    delete file;
+  }
+}
+
+
+template class Simulation<float ,1u>;
+template class Simulation<double ,1u>;
+template class Simulation<long double ,1u>;
+template class Simulation<std::complex<float> ,1u>;
+template class Simulation<std::complex<double> ,1u>;
+template class Simulation<std::complex<long double> ,1u>;
+
+template class Simulation<float ,3u>;
+template class Simulation<double ,3u>;
+template class Simulation<long double ,3u>;
+template class Simulation<std::complex<float> ,3u>;
+template class Simulation<std::complex<double> ,3u>;
+template class Simulation<std::complex<long double> ,3u>;
+
+template class Simulation<float ,2u>;
+template class Simulation<double ,2u>;
+template class Simulation<long double ,2u>;
+template class Simulation<std::complex<float> ,2u>;
+template class Simulation<std::complex<double> ,2u>;
+template class Simulation<std::complex<long double> ,2u>;
@@ -13,6 +13,8 @@ class Simulation;
 #include "Global.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Config.hpp"
+#include "Diagnostics.hpp"
 #include "Random.hpp"
 #include "Coordinates.hpp"
 #include "LatticeStructure.hpp"
@@ -23,6 +25,7 @@ class Simulation;
 #include "Simulation.hpp"
 #include "SimulationGlobal.hpp"
 #include "messages.hpp"
+#include "Merge.hpp"
 
 typedef int indextype;
 
@@ -44,16 +47,43 @@ int main(int argc, char *argv[]){
     exit(1);
   }
 
+  // KITEx --merge a.h5 b.h5 ... -o out.h5 combines the outputs of independent runs
+  if(std::string(argv[1]) == "--merge"){
+    std::vector<std::string> inputs;
+    std::string output;
+    for(int i = 2; i < argc; i++){
+      if(std::string(argv[i]) == "-o" && i + 1 < argc)
+        output = argv[++i];
+      else
+        inputs.push_back(argv[i]);
+    }
+    if(output.empty()){
+      std::cout << "Usage: KITEx --merge a.h5 b.h5 ... -o out.h5. Exiting.\n";
+      exit(1);
+    }
+    return merge_outputs(inputs, output);
+  }
+
+  // KITEx --autotune config.h5 chooses the fastest /Divisions before running the calculations
+  bool autotune = false;
+  if(std::string(argv[1]) == "--autotune"){
+    if(argc < 3){
+      std::cout << "Usage: KITEx --autotune config.h5. Exiting.\n";
+      exit(1);
+    }
+    autotune = true;
+    argv++;
+  }
+
   /* Define General characteristics of the data */  
   int precision = 1, dim, is_complex;
 
-  H5::H5File *file = new H5::H5File(argv[1], H5F_ACC_RDONLY);
+  H5::H5File * file = Config::open(argv[1]);
   get_hdf5(&is_complex, file, (char *) "/IS_COMPLEX");
   get_hdf5(&precision,  file, (char *) "/PRECISION");
   get_hdf5(&dim,        file, (char *) "/DIM");
   
   
-  file->close();
   
   // Verify if the values passed to the program are valid. If they aren't
   // the program should notify the user and exit with error 1.
@@ -77,92 +107,92 @@ int main(int argc, char *argv[]){
   switch (index ) {
   case 0:
     {
-      class GlobalSimulation <float, 1u> h(argv[1]); // float real 1D
+      class GlobalSimulation <float, 1u> h(argv[1], autotune); // float real 1D
       break;
     }
   case 1:
     {
-      class GlobalSimulation <float, 2u> h(argv[1]); // float real 2D
+      class GlobalSimulation <float, 2u> h(argv[1], autotune); // float real 2D
       break;
     }
   case 2:
     {
-      class GlobalSimulation <float, 3u> h(argv[1]); // float real 3D
+      class GlobalSimulation <float, 3u> h(argv[1], autotune); // float real 3D
       break;
     }
   case 3:
       {
-      class GlobalSimulation <double, 1u> h(argv[1]); // double real 1D
+      class GlobalSimulation <double, 1u> h(argv[1], autotune); // double real 1D
       break;
       }
   case 4:
       {
-      class GlobalSimulation <double, 2u> h(argv[1]); //double real 2D. You get the picture.
+      class GlobalSimulation <double, 2u> h(argv[1], autotune); //double real 2D. You get the picture.
       break;
       }
   case 5:
       {
-      class GlobalSimulation <double, 3u> h(argv[1]);
+      class GlobalSimulation <double, 3u> h(argv[1], autotune);
       break;
       }
   case 6:
       {
-      class GlobalSimulation <long double, 1u> h(argv[1]);
+      class GlobalSimulation <long double, 1u> h(argv[1], autotune);
       break;
       }
   case 7:
       {
-      class GlobalSimulation <long double, 2u> h(argv[1]);
+      class GlobalSimulation <long double, 2u> h(argv[1], autotune);
       break;
       }
   case 8:
       {
-      class GlobalSimulation <long double, 3u> h(argv[1]);
+      class GlobalSimulation <long double, 3u> h(argv[1], autotune);
       break;
       }
   case 9:
       {
-      class GlobalSimulation <std::complex<float>, 1u> h(argv[1]);
+      class GlobalSimulation <std::complex<float>, 1u> h(argv[1], autotune);
       break;
       }
   case 10:
       {
-      class GlobalSimulation <std::complex<float>, 2u> h(argv[1]);
+      class GlobalSimulation <std::complex<float>, 2u> h(argv[1], autotune);
       break;
       }
   case 11:
       {
-      class GlobalSimulation <std::complex<float>, 3u> h(argv[1]);
+      class GlobalSimulation <std::complex<float>, 3u> h(argv[1], autotune);
       break;
       }
   case 12:
       {
-      class GlobalSimulation <std::complex<double>, 1u> h(argv[1]);
+      class GlobalSimulation <std::complex<double>, 1u> h(argv[1], autotune);
       break;
       }
   case 13:
       {
-      class GlobalSimulation <std::complex<double>, 2u> h(argv[1]);
+      class GlobalSimulation <std::complex<double>, 2u> h(argv[1], autotune);
       break;
       }
   case 14:
       {
-      class GlobalSimulation <std::complex<double>, 3u> h(argv[1]);
+      class GlobalSimulation <std::complex<double>, 3u> h(argv[1], autotune);
       break;
       }
   case 15:
       {
-      class GlobalSimulation <std::complex<long double>, 1u> h(argv[1]);
+      class GlobalSimulation <std::complex<long double>, 1u> h(argv[1], autotune);
       break;
       }
   case 16:
       {
-      class GlobalSimulation <std::complex<long double>, 2u> h(argv[1]);
+      class GlobalSimulation <std::complex<long double>, 2u> h(argv[1], autotune);
       break;
       }
   case 17:
       {
-      class GlobalSimulation <std::complex<long double>, 3u> h(argv[1]);
+      class GlobalSimulation <std::complex<long double>, 3u> h(argv[1], autotune);
       break;
       }
   default:
@@ -9,6 +9,7 @@
 #include "Generic.hpp"
 #include "ComplexTraits.hpp"
 #include "myHDF5.hpp"
+#include "Diagnostics.hpp"
 
 template<>
 H5::DataType DataTypeFor<int>::value = H5::PredType::NATIVE_INT;
@@ -30,6 +31,7 @@ template <typename T>
 typename std::enable_if<!is_tt<std::complex, T>::value, void>::type write_hdf5(const Eigen::Array<T, -1, -1 > & mu,
                                                                                              H5::H5File *  file,
                                                                                              const std::string  name) {
+  ScopedTimer timer(Diagnostics::IO);
   hsize_t    dims[2], chunk_dims[2]; // dataset dimensions
   dims[0] = chunk_dims[0] = mu.cols();
   dims[1] = chunk_dims[1] = mu.rows();      
@@ -55,6 +57,7 @@ template <typename T>
 typename std::enable_if<is_tt<std::complex, T>::value, void>::type write_hdf5(const Eigen::Array<T, -1, -1 > & mu,
 									      H5::H5File * file,
                                                                                         const std::string name) {
+  ScopedTimer timer(Diagnostics::IO);
   hsize_t    dims[2], chunk_dims[2]; // dataset dimensions
   dims[0] = chunk_dims[0] = mu.cols();
   dims[1] = chunk_dims[1] = mu.rows();      
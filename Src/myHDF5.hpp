@@ -16,6 +16,21 @@ public:
 
 
 
+template <typename T>
+typename std::enable_if<!is_tt<std::complex, T>::value, H5::DataType>::type hdf5_datatype(){
+  return DataTypeFor<T>::value;
+}
+
+template <typename T>
+typename std::enable_if<is_tt<std::complex, T>::value, H5::CompType>::type hdf5_datatype(){
+  // Same layout as the complex datasets of write_hdf5
+  typedef typename extract_value_type<T>::value_type value_type;
+  H5::CompType complex_datatype(sizeof(T));
+  complex_datatype.insertMember("r", 0, DataTypeFor<value_type>::value);
+  complex_datatype.insertMember( "i", sizeof(value_type), DataTypeFor<value_type>::value);
+  return complex_datatype;
+}
+
 template <typename T>
 typename std::enable_if<is_tt<std::complex, T>::value, void>::type get_hdf5(T * l, H5::H5File *  file,  char * name) {
   H5::DataSet dataset = H5::DataSet(file->openDataSet(name));
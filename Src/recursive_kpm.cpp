@@ -7,299 +7,283 @@
 
 
 
-//template <typename T,unsigned D>
-//void Simulation<T,D>::Measure_Gamma(measurement_queue queue) {
-  //debug_message("Entered Measure_Gamma.\n");
-  /* Calculates the Gamma matrix of parameters given by 'indices_string'. These matrices
-     are used to calculate various properties of the quantum system, such as the density
-     of states and the optical conductivity. The Gamma matrix is a multi-dimensional matrix 
-     defined by:
-		
+#include "Generic.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Global.hpp"
+#include "Diagnostics.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+template <typename T, unsigned D>
+class Hamiltonian;
+template <typename T, unsigned D>
+class KPM_Vector;
+#include "Simulation.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::GammaGeneral(int NRandomV, int NDisorder, std::vector<int> N_moments,
+                                   std::vector<std::vector<unsigned>> indices, std::string name_dataset){
+  /* Calculates the Gamma matrix of any dimension. These matrices are used to calculate
+     various properties of the quantum system, such as the density of states and the
+     optical conductivity. The Gamma matrix is a multi-dimensional matrix defined by:
+
      Gamma{i1, i2, ... , iN}(n1, n2, ..., nN) = < v^i1  T_n1(H)  v^i2  T_n2(H) ... v^iN  T_nN(H) >
-			
-     The first argument is the parameters and the second argument is the matrix indices. Here's 
-     a quick rundown of what each of these objects means:
-		 
-     T_n(H) is the n-th order Chebyshev polynomial of the Hamiltonian matrix H
-			
-     Note that each i in the parameters actually stands for a set of letters, such as x, or xx, or xyyxxy.
-     Unwinding those, v^{ij...mn} represents the  nested commutator of the position operator:
-		
+
+     T_n(H) is the n-th order Chebyshev polynomial of the Hamiltonian matrix H. Each i stands
+     for a set of directions, such as x, or xx, or xyyxxy, and v^{ij...mn} represents the nested
+     commutator of the position operator:
+
      v^{x} = [x,H],  v^{xy} = [x,[y,H]],  v^{yyy} = [y,[y,[y,H]]],  etc...
-			
-     Note that these velocity operators do not have the imaginary number in their definition, so they are not
-     hermitian. When the parameter of v is empty, it is treated as the identity operator: v^{} = 1.		
-     Some valid parameters for the Gamma matrix are: 
-		
-     ""   		  ->   G^{}(n) = < Tn(H) > 
-     "x" 		  	->   G^{x}(n) = < v^x  Tn(H) >
-     "xyyyxyx"	->   G^{xyyyxyx}(n) = < v^xyyyxyx  Tn(H) >
+
+     When the set of directions is empty, v^{} = 1. Some examples, in the format of process_string:
+
+     ""   		  ->   G^{}(n) = < Tn(H) >
      "xy,y"		  ->	 G^{xy,y}(n,m) = < v^x  Tn(H)  v^y  Tm(H) >
-     ","		  	->	 G^{,}(n,m) = < Tn(H)  Tm(H) >
      "y,,y,"		->	 G^{y,,y,}(n,m,p,q) = < v^y  Tn(H)  Tm(H)  v^y  Tp(H)  Tq(H) >
-     etc...	  	->	 etc...
-		
-     These parameters should NOT contain anything else other than the characters ',', 'x' and 'y',
-     not even whitespace characters. The dimension of the Gamma matrix is the number of commas + 1 */
-		
-		
-
-
-  // Obtain the quantities needed for the simulation from the queue
-  //int NRandomV = queue.NRandom;
-  //int NDisorder = queue.NDisorder;
-  //std::vector<int> N_moments = queue.NMoments;
-  //std::string indices_string = queue.direction_string;
-  //std::string name_dataset = queue.label;
- 
-  //debug_message("Indices: "); debug_message(indices_string); debug_message(".\n");
-		
-
-
-  //// First of all, we need to process the indices_string into something the program can use
-//#pragma omp barrier
-  //std::vector<std::vector<unsigned>> indices = process_string(indices_string);
-  //int dim = indices.size();
-		
-		
-		
-  //// Check if the dimensions match
-  //if(dim != int(N_moments.size())){
-    //std::cout << "Dimension of the Gamma matrix does not match the number of chebyshev moments. Aborting.\n";
-    //exit(1);
-  //}
-    
-  //if(dim == 2 and MEMORY > 2){
-    //if(N_moments.at(0)%MEMORY!=0 or N_moments.at(1)%MEMORY!=0){
-      //std::cout << "The number of Chebyshev moments ("<< N_moments.at(0)<<","<< N_moments.at(1)<<")"; 
-      //std::cout << "has to be a multiple of MEMORY ("<< MEMORY <<"). Exiting.\n";
-      //exit(1);
-    //}
-    //Gamma2D(NRandomV, NDisorder, N_moments, indices, name_dataset);
-  //} else {
-    //if(dim == 3){
-      //Gamma3D(NRandomV, NDisorder, N_moments, indices, name_dataset);
-    //} else {
-      //Gamma1D(NRandomV, NDisorder, N_moments.at(0), indices, name_dataset);
-      ////GammaGeneral(NRandomV, NDisorder, N_moments, indices, name_dataset);
-    //}
-  //}
-  
-  
-  //debug_message("Left Measure_Gamma\n");
-//};
-
-
-//template <typename T,unsigned D>
-//void Simulation<T,D>::recursive_KPM(int depth, int max_depth, std::vector<int> N_moments, long *average, long *index_gamma, 
-                   //std::vector<std::vector<unsigned>> indices, std::vector<KPM_Vector<T,D>*> *kpm_vector, Eigen::Array<T, -1, -1> *gamma){
-  //debug_message("Entered recursive_KPM\n");
-  //typedef typename extract_value_type<T>::value_type value_type;
-  //Eigen::Matrix < T, 1, 2> tmp =  Eigen::Matrix < T, 1, 2> ::Zero();		
-		
-		
-  //if(depth != max_depth){
-    //KPM_Vector<T,D> *kpm1 = kpm_vector->at(depth);
-    //KPM_Vector<T,D> *kpm2 = kpm_vector->at(depth + 1);
-			
-    //T * kpm1data;
-    //T * kpm2data;
-			
-    ////std::cout << "first branch. Depth: " << depth << "\n" << std::flush;
-			
-			
-    //for(int p = 0; p < N_moments.at(depth - 1); p++){
-      //kpm2->set_index(0);
-      //switch(indices.at(depth).size()){
-      //case 0:
-        //break;
-      //default:
-        //kpm1data = kpm1->v.col(kpm1->get_index()).data();
-        //kpm2data = kpm2->v.col(kpm2->get_index()).data();
-                  
-        //kpm2->Velocity(kpm2data, kpm1data, max_depth - depth); 											
-      //}
-				
-      //recursive_KPM(depth + 1, max_depth, N_moments, average, index_gamma, indices, kpm_vector, gamma);
-      //if(p == 0){
-        //kpm1->template Multiply<0>(); 
-      //}
-      //else if(p < N_moments.at(depth-1) - 1){
-        //kpm1->template Multiply<1>(); 
-      //}
-    //}
-			
-  //} else {
-    //KPM_Vector<T,D> *kpm0 = kpm_vector->at(0);
-    //KPM_Vector<T,D> *kpm1 = kpm_vector->at(depth);
-			
-    //kpm1->template Multiply<0>();		
-    //tmp.setZero();
-    //for(std::size_t ii = 0; ii < r.Sized ; ii += r.Ld[0])
-      //tmp += kpm0->v.block(ii,0, r.Ld[0], 1).adjoint() * kpm1->v.block(ii, 0, r.Ld[0], 2);
-    //gamma->matrix().block(0,*index_gamma,1,2) += (tmp - gamma->matrix().block(0,*index_gamma,1,2))/value_type(*average + 1);			
-    //*index_gamma += 2;
-	
-    //for(int m = 2; m < N_moments.at(depth - 1); m += 2){
-      //kpm1->template Multiply<1>();
-      //kpm1->template Multiply<1>();
-      //tmp.setZero();
-      //for(std::size_t ii = 0; ii < r.Sized ; ii += r.Ld[0])
-        //tmp += kpm0->v.block(ii,0, r.Ld[0], 1).adjoint() * kpm1->v.block(ii, 0, r.Ld[0], 2);
-      //gamma->matrix().block(0, *index_gamma,1,2) += (tmp - gamma->matrix().block(0,*index_gamma,1,2))/value_type(*average + 1);
-            
-      //*index_gamma += 2;
-    //}
-  //}
-		
-  //debug_message("Left recursive_KPM\n");
-//};
-//
-//
-
-
-
-//template <typename T,unsigned D>
-//void Simulation<T,D>::GammaGeneral(int NRandomV, int NDisorder, std::vector<int> N_moments,
-                                   //std::vector<std::vector<unsigned>> indices, std::string name_dataset){
-    
-  //int dim = indices.size();
-		
-  //// Check if the dimensions match
-  //if(dim != int(N_moments.size())){
-    //std::cout << "Dimension of the Gamma matrix does not match the number of chebyshev moments. Aborting.\n";
-    //exit(1);
-  //}
-			
-  //// Determine the size of the gamma matrix we want to calculate
-  //int size_gamma = 1;
-  //for(int i = 0; i < dim; i++){
-    //if(N_moments.at(i) % 2 != 0){
-      //std::cout << "The number of moments must be an even number, due to limitations of the program. Aborting\n";
-      //exit(1);
-    //}
-    //size_gamma *= N_moments.at(i);
-  //}
-		
-		
-  //// Initialize the KPM vectors that will be needed to run the program 
-  //std::vector<KPM_Vector<T,D>*> kpm_vector(dim+1);
-  //kpm_vector.at(0) = new KPM_Vector<T,D> (1, *this);
-  //for(int i = 0; i < dim; i++)
-    //kpm_vector.at(i+1) = new KPM_Vector<T,D> (2, *this);
-		
-		
-  //// Define some pointers to make the code easier to read
-  //KPM_Vector<T,D> *kpm0 = kpm_vector.at(0);
-  //KPM_Vector<T,D> *kpm1 = kpm_vector.at(1);
-			
-  //// Make sure the local gamma matrix is zeroed
-  //Eigen::Array<T, -1, -1> gamma = Eigen::Array<T, -1, -1 >::Zero(1, size_gamma);
-
-  //long average = 0;
-  //for(int disorder = 0; disorder < NDisorder; disorder++){
-    //h.generate_disorder();
-    //for(unsigned it = 0; it < indices.size(); it++)
-      //h.build_velocity(indices.at(it), it);
-
-    //for(int randV = 0; randV < NRandomV; randV++){
-        
-      //kpm0->initiate_vector();			// original random vector
-      //kpm1->set_index(0);
-      //kpm1->v.col(0) = kpm0->v.col(0);
-      //kpm1->Exchange_Boundaries();
-
-      //// replace <0| by  <0|v. Note that v is not self-adjoint in this formulation
-      //generalized_velocity(kpm0, kpm1, indices, 0);
-      //int factor = 1 - (indices.at(0).size() % 2)*2;		
-      //kpm0->v.col(0) = factor*kpm0->v.col(0); // This factor is due to the fact that this Velocity operator is not self-adjoint
-
-      //kpm0->empty_ghosts(0);
-      //long index_gamma = 0;
-      //recursive_KPM(1, dim, N_moments, &average, &index_gamma, indices, &kpm_vector, &gamma);
-      //average++;
-    //}
-  //} 
-		
-		
-  //store_gamma(&gamma, N_moments, indices, name_dataset);
-		
-  //// delete the kpm_vector
-  //delete kpm_vector.at(0);
-  //for(int i = 0; i < dim; i++)
-    //delete kpm_vector.at(i+1);
-	
-//}
-
-//template <typename T,unsigned D>
-//void Simulation<T,D>::GammaGeneral(int NRandomV, int NDisorder, std::vector<int> N_moments,
-                                   //std::vector<std::vector<unsigned>> indices, std::string name_dataset){
-    
-  //int dim = indices.size();
-		
-  //// Check if the dimensions match
-  //if(dim != int(N_moments.size())){
-    //std::cout << "Dimension of the Gamma matrix does not match the number of chebyshev moments. Aborting.\n";
-    //exit(1);
-  //}
-			
-  //// Determine the size of the gamma matrix we want to calculate
-  //int size_gamma = 1;
-  //for(int i = 0; i < dim; i++){
-    //if(N_moments.at(i) % 2 != 0){
-      //std::cout << "The number of moments must be an even number, due to limitations of the program. Aborting\n";
-      //exit(1);
-    //}
-    //size_gamma *= N_moments.at(i);
-  //}
-		
-		
-  //// Initialize the KPM vectors that will be needed to run the program 
-  //std::vector<KPM_Vector<T,D>*> kpm_vector(dim+1);
-  //kpm_vector.at(0) = new KPM_Vector<T,D> (1, *this);
-  //for(int i = 0; i < dim; i++)
-    //kpm_vector.at(i+1) = new KPM_Vector<T,D> (2, *this);
-		
-		
-  //// Define some pointers to make the code easier to read
-  //KPM_Vector<T,D> *kpm0 = kpm_vector.at(0);
-  //KPM_Vector<T,D> *kpm1 = kpm_vector.at(1);
-			
-  //// Make sure the local gamma matrix is zeroed
-  //Eigen::Array<T, -1, -1> gamma = Eigen::Array<T, -1, -1 >::Zero(1, size_gamma);
-
-  //long average = 0;
-  //for(int disorder = 0; disorder < NDisorder; disorder++){
-    //h.generate_disorder();
-    //for(unsigned it = 0; it < indices.size(); it++)
-      //h.build_velocity(indices.at(it), it);
-
-    //for(int randV = 0; randV < NRandomV; randV++){
-        
-      //kpm0->initiate_vector();			// original random vector
-      //kpm1->set_index(0);
-      //kpm1->v.col(0) = kpm0->v.col(0);
-      //kpm1->Exchange_Boundaries();
-
-      //// replace <0| by  <0|v. Note that v is not self-adjoint in this formulation
-      //generalized_velocity(kpm0, kpm1, indices, 0);
-      //int factor = 1 - (indices.at(0).size() % 2)*2;		
-      //kpm0->v.col(0) = factor*kpm0->v.col(0); // This factor is due to the fact that this Velocity operator is not self-adjoint
-
-      //kpm0->empty_ghosts(0);
-      //long index_gamma = 0;
-      //recursive_KPM(1, dim, N_moments, &average, &index_gamma, indices, &kpm_vector, &gamma);
-      //average++;
-    //}
-  //} 
-		
-		
-  //store_gamma(&gamma, N_moments, indices, name_dataset);
-		
-  //// delete the kpm_vector
-  //delete kpm_vector.at(0);
-  //for(int i = 0; i < dim; i++)
-    //delete kpm_vector.at(i+1);
-	
-//}
 
+     The trace is split in a bra and a ket:
+
+     <r| v^i1 T_n1 ... v^iN T_nN |r>  =  factor * <B(n1,...,nN-1)| T_nN |r>
+     |B(n1,...,nN-1)> = v^iN T_nN-1 v^iN-1 ... T_n1 v^i1 |r>
+
+     The bra vectors are calculated by recursive_KPM, one Chebyshev index per level of the
+     recursion. Each level keeps its own Chebyshev recursion, so the vectors of a level are
+     iterated only once for each set of the outer indices. The last level collects MEMORY bra
+     vectors at a time and contract_general multiplies them by all the ket vectors T_nN|r> at
+     once. These do not depend on the bra, so as many of them as allowed by MEMORY_BUDGET are
+     calculated once per random vector and kept, and the remaining ones are recalculated in
+     blocks of MEMORY from the last two kept vectors.
+
+     The matrix is flattened with n1 the fastest index, as in Gamma2D and Gamma3D, and stored
+     with N1 x ... x NN-1 rows and NN columns, without the symmetrization of store_gamma. It is
+     accumulated directly in Global.general_gamma, so each thread only keeps the
+     MEMORY x N_nN partial block in its own column of Global.smaller_gamma */
+
+  debug_message("Entered GammaGeneral\n");
+  int dim = indices.size();
+
+  // Check if the dimensions match
+  if(dim != int(N_moments.size()) or dim == 0){
+    std::cout << "Dimension of the Gamma matrix does not match the number of chebyshev moments. Aborting.\n";
+    exit(1);
+  }
+
+  int num_velocities = 0;
+  for(int i = 0; i < dim; i++)
+    num_velocities += indices.at(i).size();
+  int factor = 1 - (num_velocities % 2)*2;
+
+  //  --------- INITIALIZATIONS --------------
+
+  GammaWorkspace<T,D> work;
+  work.N_moments = N_moments;
+  work.indices = indices;
+  work.stride = std::vector<long>(dim + 1, 1);
+  for(int i = 0; i < dim; i++)
+    work.stride.at(i + 1) = work.stride.at(i)*N_moments.at(i);
+
+  const int N_ket = N_moments.at(dim - 1);
+  const int bra_cols = dim > 1 ? MEMORY : 1;
+
+  work.kpm0  = new KPM_Vector<T,D> (1, *this);
+  work.kpm_v = new KPM_Vector<T,D> (1, *this);
+  work.kpm_cheb.resize(dim - 1);
+  for(int i = 0; i < dim - 1; i++)
+    work.kpm_cheb.at(i) = new KPM_Vector<T,D> (2, *this);
+  work.bra = Eigen::Matrix<T,-1,-1>::Zero(r.Size, bra_cols);
+
+  work.stored = plan_stored_vectors(N_ket);
+  work.ket = Eigen::Matrix<T,-1,-1>::Zero(r.Size, work.stored);
+  work.kpm_seed = new KPM_Vector<T,D> (2, *this);
+  work.kpm_ket  = work.stored < N_ket ? new KPM_Vector<T,D> (MEMORY, *this) : NULL;
+
+#pragma omp master
+  {
+    Global.general_gamma = Eigen::Array<T, -1, -1>::Zero(1, work.stride.at(dim));
+    Global.smaller_gamma = Eigen::Array<T, -1, -1>::Zero(bra_cols*N_ket, r.n_threads);
+  }
+#pragma omp barrier
+  const long rows_gamma = long(bra_cols)*N_ket;
+  work.row0 = rows_gamma*r.thread_id/r.n_threads;
+  work.row1 = rows_gamma*(r.thread_id + 1)/r.n_threads;
+
+  // finished initializations
+
+  work.average = 0;
+  progress_start(name_dataset, long(NDisorder)*NRandomV);
+  for(int disorder = 0; disorder < NDisorder; disorder++){
+    h.generate_disorder();
+    for(unsigned it = 0; it < indices.size(); it++)
+      h.build_velocity(indices.at(it), it);
+
+    for(int randV = 0; randV < NRandomV; randV++){
+      KPM_Vector<T,D> *kpm0 = work.kpm0;
+      kpm0->initiate_vector();			// original random vector. This sets the index to zero
+      probe_vector(kpm0);
+      kpm0->Exchange_Boundaries();
+
+      // The ket vectors that fit in the memory. The last two are kept with their ghosts
+      // to restart the Chebyshev recursion of the remaining ones
+      KPM_Vector<T,D> *kpm_seed = work.kpm_seed;
+      kpm_seed->set_index(0);
+      kpm_seed->v.col(0) = kpm0->v.col(0);
+      for(int m = 0; m < work.stored; m++){
+        if(m != 0) cheb_iteration(kpm_seed, m - 1);
+        gather_interior(kpm_seed, work.ket, m);
+      }
+
+      if(dim == 1){
+        work.kpm_v->set_index(0);
+        velocity_or_copy(work.kpm_v, kpm0, indices, 0);
+        gather_interior(work.kpm_v, work.bra, 0);
+        contract_general(0, 1, work);
+      } else {
+        work.kpm_cheb.at(0)->set_index(0);
+        velocity_or_copy(work.kpm_cheb.at(0), kpm0, indices, 0);
+        recursive_KPM(0, 0, work);
+      }
+      work.average++;
+      progress_sample();
+    }
+  }
+  progress_finish();
+
+#pragma omp master
+  {
+    Eigen::Array<T,-1,-1> general_gamma = T(factor)*Eigen::Map<Eigen::Array<T,-1,-1>>(Global.general_gamma.data(), work.stride.at(dim - 1), N_ket);
+    H5::H5File * file = new H5::H5File(name, H5F_ACC_RDWR);
+    write_hdf5(general_gamma, file, name_dataset);
+    delete file;
+  }
+#pragma omp barrier
+  store_weight(name_dataset, work.average);
+
+  delete work.kpm0;
+  delete work.kpm_v;
+  delete work.kpm_seed;
+  delete work.kpm_ket;
+  for(int i = 0; i < dim - 1; i++)
+    delete work.kpm_cheb.at(i);
+
+  debug_message("Left GammaGeneral\n");
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::recursive_KPM(int depth, long index_gamma, GammaWorkspace<T,D> & work){
+  // Iterates over the Chebyshev index 'depth' of the bra. work.kpm_cheb.at(depth) already
+  // contains v^i(depth) applied to the vector of the previous level. index_gamma is the
+  // position in the flattened Gamma of the outer indices fixed by the previous levels
+  debug_message("Entered recursive_KPM\n");
+  const int dim = work.indices.size();
+  const int N = work.N_moments.at(depth);
+  KPM_Vector<T,D> *kpm = work.kpm_cheb.at(depth);
+
+  if(depth < dim - 2){
+    // Not the last level of the bra: hand each Chebyshev vector, multiplied by the next
+    // velocity, to the next level
+    KPM_Vector<T,D> *next = work.kpm_cheb.at(depth + 1);
+    for(int n = 0; n < N; n++){
+      if(n != 0) cheb_iteration(kpm, n - 1);
+      next->set_index(0);
+      velocity_or_copy(next, kpm, work.indices, depth + 1);
+      recursive_KPM(depth + 1, index_gamma + work.stride.at(depth)*n, work);
+    }
+  } else {
+    // Last level of the bra: collect MEMORY vectors and contract them with all the kets
+    for(int n = 0; n < N; n += MEMORY){
+      int cols = std::min(MEMORY, N - n);
+      for(int i = n; i < n + cols; i++){
+        if(i != 0) cheb_iteration(kpm, i - 1);
+        work.kpm_v->set_index(0);
+        velocity_or_copy(work.kpm_v, kpm, work.indices, depth + 1);
+        gather_interior(work.kpm_v, work.bra, i - n);
+      }
+      contract_general(index_gamma + work.stride.at(depth)*n, cols, work);
+    }
+  }
+  debug_message("Left recursive_KPM\n");
+}
+
+
+template <typename T,unsigned D>
+void Simulation<T,D>::contract_general(long index_gamma, int cols, GammaWorkspace<T,D> & work){
+  // Contracts the first 'cols' bra vectors with all the ket vectors T_m|r> and adds the
+  // result to the running average of Global.general_gamma. The bra vectors correspond to
+  // consecutive values of the last index of the bra, starting at index_gamma
+  ScopedTimer timer(Diagnostics::CONTRACT);
+  typedef typename extract_value_type<T>::value_type value_type;
+  const int dim = work.indices.size();
+  const int N_ket = work.N_moments.at(dim - 1);
+  const long stride_bra = dim > 1 ? work.stride.at(dim - 2) : 0;
+  const long stride_ket = work.stride.at(dim - 1);
+  const long bra_cols = work.bra.cols();
+
+  Eigen::Map<Eigen::Array<T, -1, -1>> partial_gamma(Global.smaller_gamma.col(r.thread_id).data(), bra_cols, N_ket);
+
+  // Stored ket vectors: a single product
+  if(work.stored > 0)
+    partial_gamma.leftCols(work.stored) = (work.bra.adjoint()*work.ket).array();
+
+  // The remaining ket vectors are recalculated MEMORY at a time
+  if(work.stored < N_ket){
+    KPM_Vector<T,D> *kpm_ket = work.kpm_ket;
+    if(work.stored == 0){
+      kpm_ket->set_index(0);
+      kpm_ket->v.col(0) = work.kpm0->v.col(0);
+    } else {
+      int last = work.kpm_seed->get_index();
+      kpm_ket->v.col(MEMORY - 2) = work.kpm_seed->v.col(1 - last);
+      kpm_ket->v.col(MEMORY - 1) = work.kpm_seed->v.col(last);
+      kpm_ket->set_index(MEMORY - 1);
+    }
+
+    for(int m = work.stored; m < N_ket; m += MEMORY){
+      int ket_cols = std::min(MEMORY, N_ket - m);
+      for(int i = m; i < m + ket_cols; i++)
+        if(i != 0) cheb_iteration(kpm_ket, i - 1);
+
+      contract(work.bra, kpm_ket, work.tmp);
+      partial_gamma.block(0, m, bra_cols, ket_cols) = work.tmp.leftCols(ket_cols).array();
+    }
+  }
+
+  // Sum the partial blocks of all the threads and update the average
+#pragma omp barrier
+  for(long k = work.row0; k < work.row1; k++){
+    long i = k%bra_cols;
+    long m = k/bra_cols;
+    if(i >= cols) continue;
+    long int index = index_gamma + stride_bra*i + stride_ket*m;
+    T sum = Global.smaller_gamma.row(k).sum();
+    Global.general_gamma(index) += (sum - Global.general_gamma(index))/value_type(work.average + 1);
+  }
+#pragma omp barrier
+}
+
+
+template void Simulation<float ,1u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<double ,1u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<long double ,1u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<std::complex<float> ,1u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<std::complex<double> ,1u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<std::complex<long double> ,1u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+
+template void Simulation<float ,2u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<double ,2u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<long double ,2u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<std::complex<float> ,2u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<std::complex<double> ,2u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<std::complex<long double> ,2u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+
+template void Simulation<float ,3u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<double ,3u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<long double ,3u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<std::complex<float> ,3u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<std::complex<double> ,3u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
+template void Simulation<std::complex<long double> ,3u>::GammaGeneral(int, int, std::vector<int>, std::vector<std::vector<unsigned>>, std::string);
@@ -0,0 +1,388 @@
+/***********************************************************/
+/*                                                         */
+/*   Copyright (C) 2018-2021, M. Andelkovic, L. Covaci,    */
+/*  A. Ferreira, S. M. Joao, J. V. Lopes, T. G. Rappoport  */
+/*                                                         */
+/***********************************************************/
+
+
+
+// kite-bench times the KPM kernels on synthetic lattices built in memory, for every scalar
+// type. It needs no configuration file and writes nothing. Usage:
+//
+//   kite-bench [--lattice square|honeycomb|cubic|multiorbital|all]
+//              [--disorder none|anderson|vacancies|defects|field|all]
+//              [--type float|double|longdouble|cfloat|cdouble|clongdouble|all]
+//              [--sites N] [--iterations N] [--divisions nx,ny[,nz]]
+//
+// For each case it reports, summed over the threads:
+//   Multiply   Multiply<1>, one Chebyshev moment of one vector per call
+//   Velocity   the velocity operator along x
+//   Exchange   Exchange_Boundaries of one vector
+//   Contract   the GEMM of MEMORY x MEMORY Gamma moments, as in Gamma2D
+// as moments (or calls) per second, GFLOP/s and effective GB/s. The flops are the nominal
+// ones of the hoppings, counting a complex operation as four real ones. The bytes are the
+// vectors that each call reads or writes once, and the ghosts for the Exchange
+
+#include "Generic.hpp"
+
+template<typename T, unsigned D>
+class Simulation;
+#include "Global.hpp"
+#include "ComplexTraits.hpp"
+#include "myHDF5.hpp"
+#include "Config.hpp"
+#include "Random.hpp"
+#include "Coordinates.hpp"
+#include "LatticeStructure.hpp"
+#include "Hamiltonian.hpp"
+#include "KPM_VectorBasis.hpp"
+#include "KPM_Vector.hpp"
+#include "queue.hpp"
+#include "Simulation.hpp"
+#include <iomanip>
+#include <sstream>
+
+struct Hopping {
+  unsigned from, to;
+  int      cell[3];   // unit cell of the orbital to, relative to that of the orbital from
+  double   t;
+};
+
+struct Lattice {
+  std::string                      name;
+  unsigned                         dim;
+  unsigned                         orbitals;
+  double                           scale;      // bound of the spectrum
+  std::vector<std::vector<double>> vectors;
+  std::vector<std::vector<double>> positions;
+  std::vector<Hopping>             hoppings;
+};
+
+struct Case {
+  Lattice      lattice;
+  std::string  disorder;
+  unsigned     L[3];
+  unsigned     nd[3];
+  int          iterations;
+};
+
+std::vector<Lattice> lattices(){
+  std::vector<Lattice> all;
+
+  Lattice square = {"square", 2, 1, 4.1, {{1, 0}, {0, 1}}, {{0, 0}}, {}};
+  for(int d = 0; d < 2; d++)
+    for(int s = -1; s <= 1; s += 2){
+      Hopping hop = {0, 0, {0, 0, 0}, -1};
+      hop.cell[d] = s;
+      square.hoppings.push_back(hop);
+    }
+  all.push_back(square);
+
+  Lattice honeycomb = {"honeycomb", 2, 2, 3.1, {{1, 0}, {0.5, 0.5*sqrt(3.0)}}, {{0, 0}, {0.5, 0.5/sqrt(3.0)}}, {}};
+  for(int c = 0; c < 3; c++){
+    int cell[2] = {c == 1 ? -1 : 0, c == 2 ? -1 : 0};
+    honeycomb.hoppings.push_back({0, 1, { cell[0],  cell[1], 0}, -1});
+    honeycomb.hoppings.push_back({1, 0, {-cell[0], -cell[1], 0}, -1});
+  }
+  all.push_back(honeycomb);
+
+  Lattice cubic = {"cubic", 3, 1, 6.1, {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}, {{0, 0, 0}}, {}};
+  for(int d = 0; d < 3; d++)
+    for(int s = -1; s <= 1; s += 2){
+      Hopping hop = {0, 0, {0, 0, 0}, -1};
+      hop.cell[d] = s;
+      cubic.hoppings.push_back(hop);
+    }
+  all.push_back(cubic);
+
+  // Square lattice with four orbitals in each site, coupled in the site and with the neighbours
+  Lattice multiorbital = {"multiorbital", 2, 4, 8.6, {{1, 0}, {0, 1}}, {}, {}};
+  for(unsigned io = 0; io < 4; io++){
+    multiorbital.positions.push_back({0, 0});
+    for(unsigned jo = 0; jo < 4; jo++){
+      if(io != jo)
+        multiorbital.hoppings.push_back({io, jo, {0, 0, 0}, 0.5});
+      for(int d = 0; d < 2; d++)
+        for(int s = -1; s <= 1; s += 2){
+          Hopping hop = {io, jo, {0, 0, 0}, io == jo ? -1 : 0.25};
+          hop.cell[d] = s;
+          multiorbital.hoppings.push_back(hop);
+        }
+    }
+  }
+  all.push_back(multiorbital);
+  return all;
+}
+
+template <typename U>
+void put(H5::H5File * file, std::string name, std::vector<U> values, long rows = -1){
+  // Dataset with rows x (values/rows) entries, column after column, as get_hdf5 reads them
+  if(rows < 0)
+    rows = values.size();
+  Eigen::Array<U, -1, -1> array = Eigen::Map<Eigen::Array<U, -1, -1>>(values.data(), rows, values.size()/rows);
+  write_hdf5(array, file, name);
+}
+
+void put_empty(H5::H5File * file, std::string name){
+  // Same as the disorder datasets that kite.py writes without disorder
+  hsize_t dims[2] = {1, 0};
+  file->createDataSet(name, H5::PredType::NATIVE_INT, H5::DataSpace(2, dims));
+}
+
+template <typename T>
+void build_configuration(const std::string & name, const Case & c){
+  // Writes into memory the datasets that kite.py would write for this case, and makes them
+  // the configuration of that name
+  const Lattice & lattice = c.lattice;
+  const unsigned D = lattice.dim;
+  H5::FileAccPropList access;
+  access.setCore(1 << 20, false);
+  H5::H5File * file = new H5::H5File(name, H5F_ACC_TRUNC, H5::FileCreatPropList::DEFAULT, access);
+
+  put<int>(file, "/IS_COMPLEX", {int(is_tt<std::complex, T>::value)});
+  put<int>(file, "/DIM", {int(D)});
+  put<unsigned>(file, "/L", std::vector<unsigned>(c.L, c.L + D));
+  put<unsigned>(file, "/Boundaries", std::vector<unsigned>(D, 1));
+  put<unsigned>(file, "/Divisions", std::vector<unsigned>(c.nd, c.nd + D));
+  put<unsigned>(file, "/NOrbitals", {lattice.orbitals});
+  put<double>(file, "/EnergyScale", {lattice.scale});
+  put<double>(file, "/EnergyShift", {0.});
+  std::vector<double> vectors, positions;
+  for(auto & v : lattice.vectors)
+    vectors.insert(vectors.end(), v.begin(), v.end());
+  for(auto & p : lattice.positions)
+    positions.insert(positions.end(), p.begin(), p.end());
+  put<double>(file, "/LattVectors", vectors, D);
+  put<double>(file, "/OrbPositions", positions, D);
+
+  // The hoppings of each orbital, with the orbital and unit cell they go to in base 3
+  file->createGroup("/Hamiltonian");
+  std::vector<std::vector<int>> d(lattice.orbitals);
+  std::vector<std::vector<T>>   t(lattice.orbitals);
+  for(auto & hop : lattice.hoppings){
+    int distance = hop.to;
+    for(int i = D - 1; i >= 0; i--)
+      distance = 3*distance + hop.cell[i] + 1;
+    d.at(hop.from).push_back(distance);
+    t.at(hop.from).push_back(T(hop.t/lattice.scale));
+  }
+  std::vector<unsigned> n_hoppings;
+  std::size_t max = 0;
+  for(auto & row : d){
+    n_hoppings.push_back(row.size());
+    max = std::max(max, row.size());
+  }
+  std::vector<int> d_flat;
+  std::vector<T>   t_flat;
+  for(unsigned io = 0; io < lattice.orbitals; io++){
+    d.at(io).resize(max, 0);
+    t.at(io).resize(max, T(0));
+    d_flat.insert(d_flat.end(), d.at(io).begin(), d.at(io).end());
+    t_flat.insert(t_flat.end(), t.at(io).begin(), t.at(io).end());
+  }
+  put<unsigned>(file, "/Hamiltonian/NHoppings", n_hoppings);
+  put<int>(file, "/Hamiltonian/d", d_flat, max);
+  put<T>(file, "/Hamiltonian/Hoppings", t_flat, max);
+  if(c.disorder == "field")
+    put<int>(file, "/Hamiltonian/MagneticFieldMul", {1});
+
+  // Gaussian Anderson disorder in all the orbitals
+  file->createGroup("/Hamiltonian/Disorder");
+  if(c.disorder == "anderson"){
+    std::vector<int> orbitals;
+    for(unsigned io = 0; io < lattice.orbitals; io++)
+      orbitals.push_back(io);
+    put<int>(file, "/Hamiltonian/Disorder/OrbitalNum", orbitals, 1);
+    put<int>(file, "/Hamiltonian/Disorder/OnsiteDisorderModelType", {1});
+    put<double>(file, "/Hamiltonian/Disorder/OnsiteDisorderMeanValue", {0.});
+    put<double>(file, "/Hamiltonian/Disorder/OnsiteDisorderMeanStdv", {1./lattice.scale});
+  } else {
+    put_empty(file, "/Hamiltonian/Disorder/OrbitalNum");
+    put_empty(file, "/Hamiltonian/Disorder/OnsiteDisorderModelType");
+    put_empty(file, "/Hamiltonian/Disorder/OnsiteDisorderMeanValue");
+    put_empty(file, "/Hamiltonian/Disorder/OnsiteDisorderMeanStdv");
+  }
+
+  // 1% of vacancies of the first orbital
+  file->createGroup("/Hamiltonian/Vacancy");
+  if(c.disorder == "vacancies"){
+    file->createGroup("/Hamiltonian/Vacancy/Type0");
+    put<double>(file, "/Hamiltonian/Vacancy/Type0/Concentration", {0.01});
+    put<int>(file, "/Hamiltonian/Vacancy/Type0/NumOrbitals", {1});
+    put<int>(file, "/Hamiltonian/Vacancy/Type0/Orbitals", {0});
+  }
+
+  // 1% of defects with an onsite energy in the first orbital and a weaker bond to the next
+  // unit cell along the first lattice vector
+  file->createGroup("/Hamiltonian/StructuralDisorder");
+  if(c.disorder == "defects"){
+    std::string type = "/Hamiltonian/StructuralDisorder/Type0/";
+    unsigned centre = 0;
+    for(unsigned i = 0; i < D; i++)
+      centre = 3*centre + 1;
+    file->createGroup(type);
+    put<double>(file, type + "Concentration", {0.01});
+    put<int>(file, type + "NumBondDisorder", {2});
+    put<int>(file, type + "NumOnsiteDisorder", {1});
+    put<int>(file, type + "NodeFrom", {0, 1});
+    put<int>(file, type + "NodeTo", {1, 0});
+    put<int>(file, type + "NodeOnsite", {0});
+    put<int>(file, type + "NumNodes", {2});
+    put<unsigned>(file, type + "NodePosition", {centre, centre + 1});
+    put<T>(file, type + "U0", {T(1./lattice.scale)});
+    put<T>(file, type + "Hopping", {T(-0.5/lattice.scale), T(-0.5/lattice.scale)});
+  }
+
+  Config::add(name, file);
+}
+
+template <typename T, unsigned D>
+void run(const Case & c, const std::string & type){
+  std::string name = "kite-bench " + c.lattice.name + " " + c.disorder + " " + type;
+  build_configuration<T>(name, c);
+
+  enum Kernel {MULTIPLY, VELOCITY, EXCHANGE, CONTRACT, KERNELS};
+  const char * kernels[KERNELS] = {"Multiply", "Velocity", "Exchange", "Contract"};
+  double seconds[KERNELS] = {};
+
+  LatticeStructure<D> rglobal(&name[0]);
+  GLOBAL_VARIABLES<T> Global;
+  Global.ghosts.resize(rglobal.get_BorderSize());
+  std::fill(Global.ghosts.begin(), Global.ghosts.end(), 0);
+  omp_set_num_threads(rglobal.n_threads);
+#pragma omp parallel default(shared)
+  {
+    Simulation<T,D> simul(&name[0], Global);
+    simul.h.generate_disorder();
+    std::vector<unsigned> x = {0};
+    simul.h.build_velocity(x, 0);
+
+    KPM_Vector<T,D> kpm0(2, simul);        // Chebyshev-iterated vector
+    KPM_Vector<T,D> kpm1(1, simul);        // kpm0 multiplied by the velocity
+    KPM_Vector<T,D> kpm2(MEMORY, simul);   // right vectors of the contraction
+    Eigen::Matrix<T,-1,-1> interior(simul.r.Size, MEMORY), tmp;
+    kpm0.Exchange_Boundaries();
+    kpm0.template Multiply<0>();
+    for(int m = 0; m < MEMORY; m++){
+      kpm2.v.col(m) = kpm0.v.col(m % 2);
+      kpm0.set_index(m % 2);
+      simul.gather_interior(&kpm0, interior, m);
+    }
+
+    auto timed = [&](Kernel kernel, auto work){
+      std::chrono::steady_clock::time_point start;
+#pragma omp barrier
+#pragma omp master
+      start = std::chrono::steady_clock::now();
+      for(int i = 0; i < c.iterations; i++)
+        work();
+#pragma omp barrier
+#pragma omp master
+      seconds[kernel] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    timed(MULTIPLY, [&](){ kpm0.template Multiply<1>(); });
+    timed(VELOCITY, [&](){ kpm1.Velocity(kpm1.v.col(0).data(), kpm0.v.col(kpm0.get_index()).data(), 0); });
+    timed(EXCHANGE, [&](){ kpm0.Exchange_Boundaries(); });
+    timed(CONTRACT, [&](){ simul.contract(interior, &kpm2, tmp); });
+  }
+  Config::release(name);
+
+  // Nominal work of one call of each kernel
+  const bool complex = is_tt<std::complex, T>::value;
+  const double sites = rglobal.Sizet, size = sizeof(T), flop = complex ? 4 : 1;
+  const double hoppings = double(c.lattice.hoppings.size())/c.lattice.orbitals + (c.disorder == "anderson" ? 1 : 0);
+  double moments[KERNELS] = {1, 1, 1, double(MEMORY)*MEMORY};
+  double flops[KERNELS] = {flop*(2*hoppings + 2)*sites, flop*2*c.lattice.hoppings.size()/c.lattice.orbitals*sites,
+                           0, flop*2*MEMORY*MEMORY*sites};
+  double bytes[KERNELS] = {3*sites*size, 2*sites*size, 2*double(rglobal.get_BorderSize())*size, 2*MEMORY*sites*size};
+
+  for(int k = 0; k < KERNELS; k++){
+    double calls = c.iterations/seconds[k];
+    std::cout << std::left << std::setw(14) << c.lattice.name << std::setw(11) << c.disorder
+              << std::setw(13) << type << std::setw(10) << kernels[k] << std::right << std::fixed
+              << std::setprecision(1) << std::setw(14) << moments[k]*calls
+              << std::setprecision(3) << std::setw(10) << flops[k]*calls*1e-9
+              << std::setw(10) << bytes[k]*calls*1e-9 << "\n";
+  }
+}
+
+template <unsigned D>
+void run_type(const Case & c, const std::string & type){
+  if(type == "float")            run<float, D>(c, type);
+  else if(type == "double")      run<double, D>(c, type);
+  else if(type == "longdouble")  run<long double, D>(c, type);
+  else if(type == "cfloat")      run<std::complex<float>, D>(c, type);
+  else if(type == "cdouble")     run<std::complex<double>, D>(c, type);
+  else if(type == "clongdouble") run<std::complex<long double>, D>(c, type);
+}
+
+int main(int argc, char *argv[]){
+  std::string lattice = "all", disorder = "all", type = "all";
+  long sites = 65536;
+  int iterations = 20;
+  std::vector<unsigned> divisions;
+  for(int i = 1; i < argc; i++){
+    std::string option = argv[i];
+    if(i + 1 >= argc){
+      std::cout << "Missing the value of " << option << ". Exiting.\n";
+      exit(1);
+    }
+    std::string value = argv[++i];
+    if(option == "--lattice")         lattice = value;
+    else if(option == "--disorder")   disorder = value;
+    else if(option == "--type")       type = value;
+    else if(option == "--sites")      sites = atol(value.c_str());
+    else if(option == "--iterations") iterations = atoi(value.c_str());
+    else if(option == "--divisions"){
+      std::stringstream stream(value);
+      std::string n;
+      while(std::getline(stream, n, ','))
+        divisions.push_back(atoi(n.c_str()));
+    } else {
+      std::cout << "Unknown option " << option << ". Exiting.\n";
+      exit(1);
+    }
+  }
+
+  const std::vector<std::string> disorders = {"none", "anderson", "vacancies", "defects", "field"};
+  const std::vector<std::string> types = {"float", "double", "longdouble", "cfloat", "cdouble", "clongdouble"};
+
+  std::cout << std::left << std::setw(14) << "lattice" << std::setw(11) << "disorder" << std::setw(13) << "type"
+            << std::setw(10) << "kernel" << std::right << std::setw(14) << "moments/s" << std::setw(10) << "GFLOP/s"
+            << std::setw(10) << "GB/s" << "\n";
+  for(auto & l : lattices()){
+    if(lattice != "all" && lattice != l.name)
+      continue;
+    Case c;
+    c.lattice = l;
+    c.iterations = iterations;
+
+    // The length in each direction gives about the number of sites asked for, and is a
+    // multiple of TILE times the divisions
+    for(unsigned i = 0; i < 3; i++){
+      c.nd[i] = i < divisions.size() ? divisions.at(i) : 1;
+      unsigned step = c.nd[i]*TILE;
+      unsigned length = unsigned(std::pow(double(sites), 1.0/l.dim));
+      c.L[i] = std::max(step, (length + step - 1)/step*step);
+    }
+
+    for(auto & d : disorders){
+      if(disorder != "all" && disorder != d)
+        continue;
+      c.disorder = d;
+      for(auto & t : types){
+        if(type != "all" && type != t)
+          continue;
+        // The magnetic field needs complex hoppings and a 2D lattice
+        if(d == "field" && (t.at(0) != 'c' || l.dim != 2))
+          continue;
+        if(l.dim == 2)
+          run_type<2u>(c, t);
+        else
+          run_type<3u>(c, t);
+      }
+    }
+  }
+  return 0;
+}
@@ -507,6 +507,11 @@ class Calculation:
         """Returns the requested nonlinear optical conductivity functions."""
         return self._conductivity_optical_nonlinear
 
+    @property
+    def get_gamma(self):
+        """Returns the requested Gamma matrices."""
+        return self._gamma
+
     @property
     def get_singleshot_conductivity_dc(self):
         """Returns the requested singleshot DC conductivity functions."""
@@ -525,6 +530,7 @@ class Calculation:
         self._conductivity_dc = []
         self._conductivity_optical = []
         self._conductivity_optical_nonlinear = []
+        self._gamma = []
         self._gaussian_wave_packet = []
         self._singleshot_conductivity_dc = []
 
@@ -535,7 +541,7 @@ class Calculation:
                                 'zzx': 24, 'zzy': 25, 'zzz': 26}
         self._avail_dir_sngl = {'xx': 0, 'yy': 1, 'zz': 2}
 
-    def dos(self, num_points, num_moments, num_random, num_disorder=1):
+    def dos(self, num_points, num_moments, num_random, num_disorder=1, **kwargs):
         """Calculate the density of states as a function of energy
 
         Parameters
@@ -548,12 +554,35 @@ class Calculation:
             Number of random vectors to use for the stochastic evaluation of trace.
         num_disorder : int
             Number of different disorder realisations.
+
+            Optional parameter, forward doubling, which obtains the num_moments moments from num_moments/2
+            Chebyshev iterations with the identities T_2n = 2 T_n T_n - T_0 and T_2n+1 = 2 T_n+1 T_n - T_1.
+            With tolerance, the sampling stops once the relative standard error of the moments is below it,
+            and with time_budget after that many seconds. num_random and num_disorder are then the maximum
+            numbers of samples. The errors of the moments are stored next to them. With save_samples, the
+            moments of every random vector are also stored, one row each, for jackknife or bootstrap analysis.
+            The variance of the trace is reduced with probing, a period p that splits every random vector into
+            p^D vectors on the unit cells with the same position modulo p, and with dilution, which also splits
+            it by orbital. num_random is the number of random vectors before the splitting. With pdos, the
+            moments are also split by orbital, for the DOS projected on each orbital at the cost of the DOS.
+            With save_vectors, the last two vectors of every Chebyshev recursion are kept in the output file, so
+            that extend_moments can continue them later with more moments.
         """
+        doubling = kwargs.get('doubling', False)
+        tolerance = kwargs.get('tolerance', 0)
+        time_budget = kwargs.get('time_budget', 0)
+        save_samples = kwargs.get('save_samples', False)
+        probing = kwargs.get('probing', 1)
+        dilution = kwargs.get('dilution', False)
+        pdos = kwargs.get('pdos', False)
+        save_vectors = kwargs.get('save_vectors', False)
 
         self._dos.append({'num_points': num_points, 'num_moments': num_moments, 'num_random': num_random,
-                          'num_disorder': num_disorder})
+                          'num_disorder': num_disorder, 'doubling': doubling, 'tolerance': tolerance,
+                          'time_budget': time_budget, 'save_samples': save_samples, 'probing': probing,
+                          'dilution': dilution, 'pdos': pdos, 'save_vectors': save_vectors})
 
-    def ldos(self, energy, num_moments, position, sublattice, num_disorder=1):
+    def ldos(self, energy, num_moments, position, sublattice, num_disorder=1, **kwargs):
         """Calculate the density of states as a function of energy
 
         Parameters
@@ -568,12 +597,23 @@ class Calculation:
             Relative index of the unit cell where the LDOS will be calculated.
         sublattice : str or list
             Name of the sublattice at which the LDOS will be calculated.
+
+            Optional parameter, forward doubling, which obtains the moments from half the Chebyshev iterations,
+            as in dos. With probing and dilution, all the positions are obtained from one random vector for each
+            of their colours, as in dos, instead of one vector for each position. The estimate converges with
+            num_disorder, and faster the longer the period is compared to the decay of T_n(H). save_vectors keeps
+            the recursions of each position, as in dos.
         """
+        doubling = kwargs.get('doubling', False)
+        probing = kwargs.get('probing', 1)
+        dilution = kwargs.get('dilution', False)
+        save_vectors = kwargs.get('save_vectors', False)
 
         self._ldos.append({'energy': energy, 'num_moments': num_moments, 'position': np.asmatrix(position),
-                           'sublattice': sublattice, 'num_disorder': num_disorder})
+                           'sublattice': sublattice, 'num_disorder': num_disorder, 'doubling': doubling,
+                           'probing': probing, 'dilution': dilution, 'save_vectors': save_vectors})
 
-    def arpes(self, k_vector, weight, num_moments, num_disorder=1):
+    def arpes(self, k_vector, weight, num_moments, num_disorder=1, **kwargs):
         """Calculate the density of states as a function of energy
 
         Parameters
@@ -586,9 +626,14 @@ class Calculation:
             Number of polynomials in the Chebyshev expansion.
         num_disorder : int
             Number of different disorder realisations.
+
+            Optional parameter, forward doubling, which obtains the moments from half the Chebyshev iterations,
+            as in dos.
         """
+        doubling = kwargs.get('doubling', False)
 
-        self._arpes.append({'k_vector': k_vector, 'weight': weight, 'num_moments': num_moments, 'num_disorder': num_disorder})
+        self._arpes.append({'k_vector': k_vector, 'weight': weight, 'num_moments': num_moments, 'num_disorder': num_disorder,
+                            'doubling': doubling})
 
     def gaussian_wave_packet(self, num_points, num_moments, timestep, k_vector, spinor, width, mean_value,
                              num_disorder=1, **kwargs):
@@ -624,14 +669,17 @@ class Calculation:
              'timestep': timestep, 'num_disorder': num_disorder, 'spinor': spinor, 'width': width, 'k_vector': k_vector,
              'mean_value': mean_value, 'probing_point': probing_point})
 
-    def conductivity_dc(self, direction, num_points, num_moments, num_random, num_disorder=1, temperature=0):
+    def conductivity_dc(self, direction, num_points, num_moments, num_random, num_disorder=1, temperature=0,
+                        **kwargs):
         """Calculate the density of states as a function of energy
 
         Parameters
         ----------
-        direction : string
+        direction : string or list of strings
             direction in xyz coordinates along which the conductivity is calculated.
-            Supports 'xx', 'yy', 'zz', 'xy', 'xz', 'yx', 'yz', 'zx', 'zy'.
+            Supports 'xx', 'yy', 'zz', 'xy', 'xz', 'yx', 'yz', 'zx', 'zy'. A list of directions, for
+            example ['xx', 'xy'], calculates all the components with the same random vectors. KITE-tools
+            post-processes the first one by default.
         num_points : int
             Number of energy point inside the spectrum at which the DOS will be calculated.
         num_moments : int
@@ -642,18 +690,39 @@ class Calculation:
             Number of different disorder realisations.
         temperature : float
             Value of the temperature at which we calculate the response.
+
+            Optional parameters, forward symmetric, which for longitudinal directions only calculates the
+            Gamma matrix elements with n <= m and obtains the others from the hermiticity of the trace,
+            dos, which also obtains the DOS moments from the same random vectors, without a separate DOS run,
+            tolerance, time_budget and save_samples, which stop and store the sampling as in dos, probing and
+            dilution, which split the random vectors as in dos, and checkpoint, the interval in seconds between
+            the checkpoints from which an interrupted run can be continued with restart_from_checkpoint.
         """
-        if direction not in self._avail_dir_full:
+        directions = [direction] if isinstance(direction, str) else list(direction)
+        if len(directions) == 0 or any(d not in self._avail_dir_full for d in directions):
             print('The desired direction is not available. Choose from a following set: \n',
                   self._avail_dir_full.keys())
             raise SystemExit('Invalid direction!')
         else:
+            symmetric = kwargs.get('symmetric', False)
+            dos = kwargs.get('dos', False)
+            tolerance = kwargs.get('tolerance', 0)
+            time_budget = kwargs.get('time_budget', 0)
+            save_samples = kwargs.get('save_samples', False)
+            probing = kwargs.get('probing', 1)
+            dilution = kwargs.get('dilution', False)
+            checkpoint = kwargs.get('checkpoint', 0)
+
             self._conductivity_dc.append(
-                {'direction': self._avail_dir_full[direction], 'num_points': num_points, 'num_moments': num_moments,
-                 'num_random': num_random, 'num_disorder': num_disorder,
-                 'temperature': temperature})
+                {'direction': self._avail_dir_full[directions[0]],
+                 'directions': [self._avail_dir_full[d] for d in directions], 'num_points': num_points,
+                 'num_moments': num_moments, 'num_random': num_random, 'num_disorder': num_disorder,
+                 'temperature': temperature, 'symmetric': symmetric, 'dos': dos, 'tolerance': tolerance,
+                 'time_budget': time_budget, 'save_samples': save_samples, 'probing': probing,
+                 'dilution': dilution, 'checkpoint': checkpoint})
 
-    def conductivity_optical(self, direction, num_points, num_moments, num_random, num_disorder=1, temperature=0):
+    def conductivity_optical(self, direction, num_points, num_moments, num_random, num_disorder=1, temperature=0,
+                             **kwargs):
         """Calculate the density of states as a function of energy
 
         Parameters
@@ -671,16 +740,37 @@ class Calculation:
             Number of different disorder realisations.
         temperature : float
             Value of the temperature at which we calculate the response.
+
+            Optional parameters, forward symmetric, which for longitudinal directions only calculates the
+            Gamma matrix elements with n <= m and obtains the others from the hermiticity of the trace, and
+            fused, which calculates Lambda and Gamma in a single sweep with the same random vectors. The
+            fused sweep always calculates the full Gamma matrix. With dos, the DOS moments are also obtained
+            from the same random vectors, without a separate DOS run. tolerance, time_budget and save_samples
+            stop and store the sampling of Lambda and Gamma as in dos, except in the fused sweep. probing and
+            dilution split the random vectors as in dos. checkpoint writes checkpoints of Gamma as in
+            conductivity_dc, except in the fused sweep.
         """
         if direction not in self._avail_dir_full:
             print('The desired direction is not available. Choose from a following set: \n',
                   self._avail_dir_full.keys())
             raise SystemExit('Invalid direction!')
         else:
+            symmetric = kwargs.get('symmetric', False)
+            fused = kwargs.get('fused', False)
+            dos = kwargs.get('dos', False)
+            tolerance = kwargs.get('tolerance', 0)
+            time_budget = kwargs.get('time_budget', 0)
+            save_samples = kwargs.get('save_samples', False)
+            probing = kwargs.get('probing', 1)
+            dilution = kwargs.get('dilution', False)
+            checkpoint = kwargs.get('checkpoint', 0)
+
             self._conductivity_optical.append(
                 {'direction': self._avail_dir_full[direction], 'num_points': num_points, 'num_moments': num_moments,
                  'num_random': num_random, 'num_disorder': num_disorder,
-                 'temperature': temperature})
+                 'temperature': temperature, 'symmetric': symmetric, 'fused': fused, 'dos': dos,
+                 'tolerance': tolerance, 'time_budget': time_budget, 'save_samples': save_samples,
+                 'probing': probing, 'dilution': dilution, 'checkpoint': checkpoint})
 
     def conductivity_optical_nonlinear(self, direction, num_points, num_moments, num_random, num_disorder=1,
                                        temperature=0, **kwargs):
@@ -702,7 +792,11 @@ class Calculation:
         temperature : float
             Value of the temperature at which we calculate the response.
 
-            Optional parameters, forward special, a parameter that can simplify the calculation for some materials.
+            Optional parameters, forward special, a parameter that can simplify the calculation for some materials,
+            and fused, which calculates Gamma0 to Gamma3 in a single sweep with the same random vectors and
+            Chebyshev recursions. With dos, the DOS moments are also obtained from the same random vectors,
+            without a separate DOS run. probing and dilution split the random vectors as in dos. checkpoint
+            writes checkpoints of Gamma1 to Gamma3 as in conductivity_dc, except in the fused sweep.
         """
 
         if direction not in self._avail_dir_nonl:
@@ -711,11 +805,48 @@ class Calculation:
             raise SystemExit('Invalid direction!')
         else:
             special = kwargs.get('special', 0)
+            fused = kwargs.get('fused', False)
+            dos = kwargs.get('dos', False)
+            probing = kwargs.get('probing', 1)
+            dilution = kwargs.get('dilution', False)
+            checkpoint = kwargs.get('checkpoint', 0)
 
             self._conductivity_optical_nonlinear.append(
                 {'direction': self._avail_dir_nonl[direction], 'num_points': num_points,
                  'num_moments': num_moments, 'num_random': num_random, 'num_disorder': num_disorder,
-                 'temperature': temperature, 'special': special})
+                 'temperature': temperature, 'special': special, 'fused': fused, 'dos': dos, 'probing': probing,
+                 'dilution': dilution, 'checkpoint': checkpoint})
+
+    def gamma(self, direction, num_moments, num_random, num_disorder=1):
+        """Calculate the Chebyshev moments of a Gamma matrix of any dimension
+
+            Gamma(n1, ..., nN) = < v^i1 T_n1(H) v^i2 T_n2(H) ... v^iN T_nN(H) >
+
+        Parameters
+        ----------
+        direction : string
+            Directions of the velocity operators, separated by commas, one group for each Chebyshev index. An empty
+            group is the identity. For example 'x,y' is the DC conductivity Gamma and 'y,,y,' has four indices.
+        num_moments : int or list
+            Number of polynomials in the Chebyshev expansion, either the same for all the indices or one for each.
+        num_random : int
+            Number of random vectors to use for the stochastic evaluation of trace.
+        num_disorder : int
+            Number of different disorder realisations.
+        """
+
+        if any(c not in 'xyz,' for c in direction):
+            raise SystemExit('Invalid direction! Use only x, y, z and commas.')
+
+        dim = direction.count(',') + 1
+        if isinstance(num_moments, (int, np.integer)):
+            num_moments = [num_moments] * dim
+        if len(num_moments) != dim:
+            raise SystemExit('The number of moments has to be given for each of the {} indices.'.format(dim))
+
+        codes = {'x': 0, 'y': 1, 'z': 2, ',': -1}
+        self._gamma.append({'direction': [codes[c] for c in direction], 'num_moments': list(num_moments),
+                            'num_random': num_random, 'num_disorder': num_disorder})
 
     def singleshot_conductivity_dc(self, energy, direction, eta, num_moments, num_random, num_disorder=1, **kwargs):
         """Calculate the density of states as a function of energy
@@ -756,7 +887,8 @@ class Calculation:
 class Configuration:
 
     def __init__(self, divisions=(1, 1, 1), length=(1, 1, 1), boundaries=(False, False, False),
-                 is_complex=False, precision=1, spectrum_range=None):
+                 is_complex=False, precision=1, spectrum_range=None, teams=1,
+                 ensemble=1):
         """Define basic parameters used in the calculation
 
        Parameters
@@ -776,6 +908,13 @@ class Configuration:
             Energy scale which defines the scaling factor of all the energy related parameters. The scaling is done
             automatically in the background after this definition. If the term is not specified, a rough estimate of the
             bounds is found.
+       teams : int
+            Number of teams of threads that run the calculations at the same time. Each team has the number of
+            threads given by divisions, and the LDoS and ARPES are split between the teams.
+       ensemble : int
+            Number of teams of threads that share the disorder realisations (or the random vectors, when there are
+            fewer realisations than teams) of every calculation. Each team has the number of threads given by
+            divisions and its own copy of the lattice, so divisions=1 gives one realisation to each thread.
        """
 
         if spectrum_range:
@@ -796,6 +935,8 @@ class Configuration:
         self._is_complex = int(is_complex)
         self._precision = precision
         self._divisions = divisions
+        self._teams = teams
+        self._ensemble = ensemble
         self._boundaries = np.asarray(boundaries).astype(int)
 
         self._length = length
@@ -846,6 +987,16 @@ class Configuration:
         number of threads spawn."""
         return self._divisions
 
+    @property
+    def teams(self):
+        """Returns the number of teams of threads that run the calculations at the same time."""
+        return self._teams
+
+    @property
+    def ensemble(self):
+        """Returns the number of teams of threads that share the disorder realisations and random vectors."""
+        return self._ensemble
+
     @property
     def bound(self):  # -> boundaries:
         """Returns the boundary conditions in each direction, 0 - no boundary condtions, 1 - peridoc bc. """
@@ -1108,6 +1259,61 @@ def estimate_bounds(lattice, disorder=None, disorder_structural=None):
     return -a + b, a + b
 
 
+def extend_moments(filename, num_moments, calculation='dos'):
+    """Prepare an output file of KITEx to continue its Chebyshev recursions up to more moments
+
+    The run has to be done with save_vectors. The next run of KITEx on the same file, with the same number of
+    threads, only calculates the new moments, in the same disorder realisations and with the same random vectors.
+
+    Parameters
+    ----------
+    filename : str
+        Output file of KITEx.
+    num_moments : int
+        New number of polynomials in the Chebyshev expansion.
+    calculation : str
+        Either 'dos' or 'ldos'.
+    """
+    if calculation not in ['dos', 'ldos']:
+        raise SystemExit('Only the dos and ldos recursions can be extended.')
+    f = hp.File(filename, 'r+')
+    grpc_p = f['Calculation'][calculation]
+    if 'SaveVectors' not in grpc_p or not grpc_p['SaveVectors'][0]:
+        f.close()
+        raise SystemExit('The {} recursions were not kept. Use save_vectors.'.format(calculation))
+    grpc_p['NumMoments'][...] = num_moments
+    if 'Extend' in grpc_p:
+        del grpc_p['Extend']
+    grpc_p.create_dataset('Extend', data=np.asarray([1]), dtype=np.int32)
+    f.close()
+
+
+def restart_from_checkpoint(filename):
+    """Prepare a configuration file of KITEx to continue an interrupted run from its last checkpoint
+
+    The run has to be done with the checkpoint option of a conductivity. The next run of KITEx on the same file,
+    with the same number of threads, skips the Gamma matrices that were already finished and continues the one
+    that was interrupted from its last checkpoint, kept in filename + '.checkpoint'.
+
+    Parameters
+    ----------
+    filename : str
+        Configuration file of KITEx.
+    """
+    f = hp.File(filename, 'r+')
+    groups = [name for name in ['conductivity_dc', 'conductivity_optical', 'conductivity_optical_nonlinear']
+              if name in f['Calculation'] and f['Calculation'][name].get('CheckpointInterval', [0])[0] > 0]
+    if not groups:
+        f.close()
+        raise SystemExit('The run did not write checkpoints. Use the checkpoint option.')
+    for name in groups:
+        grpc_p = f['Calculation'][name]
+        if 'Restart' in grpc_p:
+            del grpc_p['Restart']
+        grpc_p.create_dataset('Restart', data=np.asarray([1]), dtype=np.int32)
+    f.close()
+
+
 def config_system(lattice, config, calculation, modification=None, **kwargs):
     """Export the lattice and related parameters to the *.h5 file
 
@@ -1327,6 +1533,10 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
           '\nwhere TILE is selected when compiling the C++ code. \n')
 
     f.create_dataset('Divisions', data=domain_dec[0:space_size], dtype='u4')
+    # number of teams of threads, each with the threads of the divisions
+    f.create_dataset('Teams', data=config.teams, dtype='u4')
+    # number of teams of threads that share the disorder realisations and random vectors
+    f.create_dataset('Ensemble', data=config.ensemble, dtype='u4')
     # space dimension of the lattice 1D, 2D, 3D
     f.create_dataset('DIM', data=space_size, dtype='u4')
     # lattice vectors. Size is same as DIM
@@ -1570,6 +1780,17 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
         grpc_p.create_dataset('NumRandoms', data=random, dtype=np.int32)
         grpc_p.create_dataset('NumPoints', data=point, dtype=np.int32)
         grpc_p.create_dataset('NumDisorder', data=dis, dtype=np.int32)
+        grpc_p.create_dataset('Doubling', data=np.asarray([calculation.get_dos[0]['doubling']]), dtype=np.int32)
+        grpc_p.create_dataset('Tolerance', data=np.asarray([calculation.get_dos[0]['tolerance']]), dtype=np.float64)
+        grpc_p.create_dataset('TimeBudget', data=np.asarray([calculation.get_dos[0]['time_budget']]),
+                              dtype=np.float64)
+        grpc_p.create_dataset('SaveSamples', data=np.asarray([calculation.get_dos[0]['save_samples']]),
+                              dtype=np.int32)
+        grpc_p.create_dataset('Probing', data=np.asarray([calculation.get_dos[0]['probing']]), dtype=np.int32)
+        grpc_p.create_dataset('Dilution', data=np.asarray([calculation.get_dos[0]['dilution']]), dtype=np.int32)
+        grpc_p.create_dataset('PDOS', data=np.asarray([calculation.get_dos[0]['pdos']]), dtype=np.int32)
+        grpc_p.create_dataset('SaveVectors', data=np.asarray([calculation.get_dos[0]['save_vectors']]),
+                              dtype=np.int32)
 
     if calculation.get_ldos:
         grpc_p = grpc.create_group('ldos')
@@ -1671,6 +1892,10 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
             grpc_p.create_dataset('Orbitals', data=np.asarray(orbitals), dtype=np.int32)
             grpc_p.create_dataset('FixPosition', data=np.asarray(fixed_positions), dtype=np.int32)
         grpc_p.create_dataset('NumDisorder', data=dis, dtype=np.int32)
+        grpc_p.create_dataset('Doubling', data=np.asarray([single_ldos['doubling']]), dtype=np.int32)
+        grpc_p.create_dataset('Probing', data=np.asarray([single_ldos['probing']]), dtype=np.int32)
+        grpc_p.create_dataset('Dilution', data=np.asarray([single_ldos['dilution']]), dtype=np.int32)
+        grpc_p.create_dataset('SaveVectors', data=np.asarray([single_ldos['save_vectors']]), dtype=np.int32)
 
     if calculation.get_arpes:
         grpc_p = grpc.create_group('arpes')
@@ -1698,6 +1923,7 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
         grpc_p.create_dataset('k_vector', data=np.asmatrix(np.asarray(k_vector_rel)), dtype=np.float32)
         grpc_p.create_dataset('NumDisorder', data=dis, dtype=np.int32)
         grpc_p.create_dataset('OrbitalWeights', data=np.asmatrix(np.asarray(spinor)))
+        grpc_p.create_dataset('Doubling', data=np.asarray([calculation.get_arpes[0]['doubling']]), dtype=np.int32)
 
     if calculation.get_gaussian_wave_packet:
         grpc_p = grpc.create_group('gaussian_wave_packet')
@@ -1731,7 +1957,7 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
     if calculation.get_conductivity_dc:
         grpc_p = grpc.create_group('conductivity_dc')
 
-        moments, random, point, dis, temp, direction = [], [], [], [], [], []
+        moments, random, point, dis, temp, direction, symmetric = [], [], [], [], [], [], []
         for single_cond_dc in calculation.get_conductivity_dc:
             moments.append(single_cond_dc['num_moments'])
             random.append(single_cond_dc['num_random'])
@@ -1739,6 +1965,7 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
             dis.append(single_cond_dc['num_disorder'])
             temp.append(single_cond_dc['temperature'])
             direction.append(single_cond_dc['direction'])
+            symmetric.append(single_cond_dc['symmetric'])
 
         if len(calculation.get_conductivity_dc) > 1:
             raise SystemExit('Only a single function request of each type is currently allowed. Please use another '
@@ -1749,11 +1976,27 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
         grpc_p.create_dataset('NumDisorder', data=np.asarray(dis), dtype=np.int32)
         grpc_p.create_dataset('Temperature', data=np.asarray(temp) / config.energy_scale, dtype=np.float64)
         grpc_p.create_dataset('Direction', data=np.asarray(direction), dtype=np.int32)
+        grpc_p.create_dataset('Symmetric', data=np.asarray(symmetric), dtype=np.int32)
+        grpc_p.create_dataset('HarvestDOS', data=np.asarray([calculation.get_conductivity_dc[0]['dos']]),
+                              dtype=np.int32)
+        grpc_p.create_dataset('Tolerance', data=np.asarray([calculation.get_conductivity_dc[0]['tolerance']]),
+                              dtype=np.float64)
+        grpc_p.create_dataset('TimeBudget', data=np.asarray([calculation.get_conductivity_dc[0]['time_budget']]),
+                              dtype=np.float64)
+        grpc_p.create_dataset('SaveSamples', data=np.asarray([calculation.get_conductivity_dc[0]['save_samples']]),
+                              dtype=np.int32)
+        grpc_p.create_dataset('Probing', data=np.asarray([calculation.get_conductivity_dc[0]['probing']]), dtype=np.int32)
+        grpc_p.create_dataset('Dilution', data=np.asarray([calculation.get_conductivity_dc[0]['dilution']]), dtype=np.int32)
+        grpc_p.create_dataset('CheckpointInterval', data=np.asarray([calculation.get_conductivity_dc[0]['checkpoint']]),
+                              dtype=np.float64)
+        if len(calculation.get_conductivity_dc[0]['directions']) > 1:
+            grpc_p.create_dataset('Directions', data=np.asarray(calculation.get_conductivity_dc[0]['directions']),
+                                  dtype=np.int32)
 
     if calculation.get_conductivity_optical:
         grpc_p = grpc.create_group('conductivity_optical')
 
-        moments, random, point, dis, temp, direction = [], [], [], [], [], []
+        moments, random, point, dis, temp, direction, symmetric, fused = [], [], [], [], [], [], [], []
         for single_cond_opt in calculation.get_conductivity_optical:
             moments.append(single_cond_opt['num_moments'])
             random.append(single_cond_opt['num_random'])
@@ -1761,6 +2004,8 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
             dis.append(single_cond_opt['num_disorder'])
             temp.append(single_cond_opt['temperature'])
             direction.append(single_cond_opt['direction'])
+            symmetric.append(single_cond_opt['symmetric'])
+            fused.append(single_cond_opt['fused'])
 
         if len(calculation.get_conductivity_optical) > 1:
             raise SystemExit('Only a single function request of each type is currently allowed. Please use another '
@@ -1771,11 +2016,27 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
         grpc_p.create_dataset('NumDisorder', data=np.asarray(dis), dtype=np.int32)
         grpc_p.create_dataset('Temperature', data=np.asarray(temp) / config.energy_scale, dtype=np.float64)
         grpc_p.create_dataset('Direction', data=np.asarray(direction), dtype=np.int32)
+        grpc_p.create_dataset('Symmetric', data=np.asarray(symmetric), dtype=np.int32)
+        grpc_p.create_dataset('Fused', data=np.asarray(fused), dtype=np.int32)
+        grpc_p.create_dataset('HarvestDOS', data=np.asarray([calculation.get_conductivity_optical[0]['dos']]),
+                              dtype=np.int32)
+        grpc_p.create_dataset('Tolerance', data=np.asarray([calculation.get_conductivity_optical[0]['tolerance']]),
+                              dtype=np.float64)
+        grpc_p.create_dataset('TimeBudget',
+                              data=np.asarray([calculation.get_conductivity_optical[0]['time_budget']]),
+                              dtype=np.float64)
+        grpc_p.create_dataset('SaveSamples',
+                              data=np.asarray([calculation.get_conductivity_optical[0]['save_samples']]),
+                              dtype=np.int32)
+        grpc_p.create_dataset('Probing', data=np.asarray([calculation.get_conductivity_optical[0]['probing']]), dtype=np.int32)
+        grpc_p.create_dataset('Dilution', data=np.asarray([calculation.get_conductivity_optical[0]['dilution']]), dtype=np.int32)
+        grpc_p.create_dataset('CheckpointInterval', data=np.asarray([calculation.get_conductivity_optical[0]['checkpoint']]),
+                              dtype=np.float64)
 
     if calculation.get_conductivity_optical_nonlinear:
         grpc_p = grpc.create_group('conductivity_optical_nonlinear')
 
-        moments, random, point, dis, temp, direction, special = [], [], [], [], [], [], []
+        moments, random, point, dis, temp, direction, special, fused = [], [], [], [], [], [], [], []
         for single_cond_opt_non in calculation.get_conductivity_optical_nonlinear:
             moments.append(single_cond_opt_non['num_moments'])
             random.append(single_cond_opt_non['num_random'])
@@ -1784,6 +2045,7 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
             temp.append(single_cond_opt_non['temperature'])
             direction.append(single_cond_opt_non['direction'])
             special.append(single_cond_opt_non['special'])
+            fused.append(single_cond_opt_non['fused'])
 
         if len(calculation.get_conductivity_optical_nonlinear) > 1:
             raise SystemExit('Only a single function request of each type is currently allowed. Please use another '
@@ -1795,6 +2057,41 @@ def config_system(lattice, config, calculation, modification=None, **kwargs):
         grpc_p.create_dataset('Temperature', data=np.asarray(temp) / config.energy_scale, dtype=np.float64)
         grpc_p.create_dataset('Direction', data=np.asarray(direction), dtype=np.int32)
         grpc_p.create_dataset('Special', data=np.asarray(special), dtype=np.int32)
+        grpc_p.create_dataset('Fused', data=np.asarray(fused), dtype=np.int32)
+        grpc_p.create_dataset('HarvestDOS', data=np.asarray([calculation.get_conductivity_optical_nonlinear[0]['dos']]),
+                              dtype=np.int32)
+        grpc_p.create_dataset('Probing', data=np.asarray([calculation.get_conductivity_optical_nonlinear[0]['probing']]), dtype=np.int32)
+        grpc_p.create_dataset('Dilution', data=np.asarray([calculation.get_conductivity_optical_nonlinear[0]['dilution']]), dtype=np.int32)
+        grpc_p.create_dataset('CheckpointInterval', data=np.asarray([calculation.get_conductivity_optical_nonlinear[0]['checkpoint']]),
+                              dtype=np.float64)
+
+    # DOS moments obtained by a conductivity calculation. The dos group is written for KITE-tools, and
+    # Harvested tells KITEx not to calculate them again
+    harvest_dos = [single for single in calculation.get_conductivity_dc + calculation.get_conductivity_optical +
+                   calculation.get_conductivity_optical_nonlinear if single['dos']]
+    if harvest_dos:
+        if calculation.get_dos or len(harvest_dos) > 1:
+            raise SystemExit('The DOS moments can only be requested once, either with dos or with the dos option of '
+                             'a single conductivity.')
+        grpc_p = grpc.create_group('dos')
+        grpc_p.create_dataset('NumMoments', data=[harvest_dos[0]['num_moments']], dtype=np.int32)
+        grpc_p.create_dataset('NumRandoms', data=[harvest_dos[0]['num_random']], dtype=np.int32)
+        grpc_p.create_dataset('NumPoints', data=[harvest_dos[0]['num_points']], dtype=np.int32)
+        grpc_p.create_dataset('NumDisorder', data=[harvest_dos[0]['num_disorder']], dtype=np.int32)
+        grpc_p.create_dataset('Harvested', data=[1], dtype=np.int32)
+
+    if calculation.get_gamma:
+        grpc_p = grpc.create_group('gamma')
+
+        if len(calculation.get_gamma) > 1:
+            raise SystemExit('Only a single function request of each type is currently allowed. Please use another '
+                             'configuration file for the same functionality.')
+        single_gamma = calculation.get_gamma[0]
+        grpc_p.create_dataset('NumMoments', data=np.asarray(single_gamma['num_moments']), dtype=np.int32)
+        grpc_p.create_dataset('NumRandoms', data=single_gamma['num_random'], dtype=np.int32)
+        grpc_p.create_dataset('NumDisorder', data=single_gamma['num_disorder'], dtype=np.int32)
+        # one code per character of the direction string: x, y, z -> 0, 1, 2 and ',' -> -1
+        grpc_p.create_dataset('Direction', data=np.asarray(single_gamma['direction']), dtype=np.int32)
 
     if calculation.get_singleshot_conductivity_dc:
         grpc_p = grpc.create_group('singleshot_conductivity_dc')
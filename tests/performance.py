@@ -0,0 +1,176 @@
+"""Performance mode of the tests.
+
+Runs the configuration of each test, with the lengths of the lattice multiplied by a factor,
+several times. For each test it records the median wall time, the peak resident memory and the
+moments per second of each calculation. The results are appended to a JSON history and compared
+with a stored baseline. A test is flagged when it is slower, or uses more memory, than the
+baseline by more than the threshold. Everything runs locally.
+
+    python performance.py [--scale 2] [--repeat 3] [--threshold 0.1] [--tests 01 02 ...]
+                          [--kitex ./KITEx] [--history performance_history.json]
+                          [--baseline performance_baseline.json] [--save-baseline]
+
+Run it from the tests directory, like start_tests.sh. The exit code is 1 if there is a
+regression. Use --save-baseline on a reference build to store its results as the baseline.
+"""
+
+import argparse
+import datetime
+import glob
+import json
+import os
+import platform
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+import h5py
+import numpy as np
+
+SEED = 3  # the seed of the tests
+
+
+def scale_configuration(original, scaled, factor):
+    # The lengths are multiples of the divisions times TILE, and remain so
+    shutil.copy(original, scaled)
+    os.chmod(scaled, 0o644)
+    with h5py.File(scaled, 'r+') as f:
+        f['L'][...] = np.asarray(f['L'][()]) * factor
+
+
+def run_once(kitex, config, log):
+    # Wall time, peak resident memory in MB and moments per second of each calculation
+    env = dict(os.environ, SEED=str(SEED), PROGRESS='1e9')
+    env.pop('PROGRESS_FILE', None)
+    with open(log, 'w') as out:
+        start = time.perf_counter()
+        process = subprocess.Popen([kitex, config], stdout=out, stderr=subprocess.STDOUT, env=env)
+        _, status, usage = os.wait4(process.pid, 0)
+        wall = time.perf_counter() - start
+    process.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1
+    if process.returncode != 0:
+        raise SystemExit('KITEx failed on {}, see {}'.format(config, log))
+
+    # The last progress line of each calculation has its totals
+    rates = {}
+    with open(log) as out:
+        for line in out:
+            match = re.match(r'Progress of (\S+): .* ([0-9.]+) moments/s, .*finished in', line)
+            if match:
+                rates[match.group(1)] = rates.get(match.group(1), 0) + float(match.group(2))
+    return wall, usage.ru_maxrss / 1024.0, rates
+
+
+def run_test(test, args, scratch):
+    config = os.path.join(scratch, 'config_{}.h5'.format(test))
+    log = os.path.join(scratch, 'log_{}'.format(test))
+    walls, memories, rates = [], [], {}
+    for _ in range(args.repeat):
+        scale_configuration(os.path.join('test_' + test, 'configORIG.h5'), config, args.scale)
+        wall, memory, rate = run_once(args.kitex, config, log)
+        walls.append(wall)
+        memories.append(memory)
+        for dataset, value in rate.items():
+            rates.setdefault(dataset, []).append(value)
+    return {'wall_time': statistics.median(walls),
+            'wall_times': walls,
+            'peak_rss_MB': max(memories),
+            'moments_per_second': {d: statistics.median(v) for d, v in rates.items()}}
+
+
+def compare(results, baseline, threshold):
+    # Regressions of each test against the baseline: (test, quantity, baseline, now)
+    regressions = []
+    for test, now in results.items():
+        before = baseline.get('tests', {}).get(test)
+        if before is None:
+            continue
+        if now['wall_time'] > before['wall_time'] * (1 + threshold):
+            regressions.append((test, 'wall time (s)', before['wall_time'], now['wall_time']))
+        if now['peak_rss_MB'] > before['peak_rss_MB'] * (1 + threshold):
+            regressions.append((test, 'peak RSS (MB)', before['peak_rss_MB'], now['peak_rss_MB']))
+        for dataset, rate in now['moments_per_second'].items():
+            old = before.get('moments_per_second', {}).get(dataset)
+            if old is not None and rate < old * (1 - threshold):
+                regressions.append((test, dataset + ' moments/s', old, rate))
+    return regressions
+
+
+def commit():
+    try:
+        return subprocess.check_output(['git', 'rev-parse', '--short', 'HEAD'], stderr=subprocess.DEVNULL,
+                                       cwd=os.path.dirname(os.path.abspath(__file__))).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Performance mode of the tests of KITEx.')
+    parser.add_argument('--scale', type=int, default=2, help='factor of the lengths of the lattices')
+    parser.add_argument('--repeat', type=int, default=3, help='runs of each test')
+    parser.add_argument('--threshold', type=float, default=0.1, help='relative change flagged as a regression')
+    parser.add_argument('--tests', nargs='*', help='numbers of the tests, all by default')
+    parser.add_argument('--kitex', default=os.path.join('.', 'KITEx'))
+    parser.add_argument('--history', default='performance_history.json')
+    parser.add_argument('--baseline', default='performance_baseline.json')
+    parser.add_argument('--save-baseline', action='store_true', help='store these results as the baseline')
+    args = parser.parse_args()
+    args.kitex = os.path.abspath(args.kitex)
+
+    tests = args.tests or sorted(d[len('test_'):] for d in glob.glob('test_*') if os.path.isdir(d))
+    scratch = tempfile.mkdtemp(prefix='kite_performance_')
+    results = {}
+    try:
+        for test in tests:
+            results[test] = run_test(test, args, scratch)
+            r = results[test]
+            rates = ', '.join('{} {:.0f}'.format(d, v) for d, v in r['moments_per_second'].items())
+            print('test_{}: {:.2f} s, {:.0f} MB, moments/s: {}'.format(test, r['wall_time'], r['peak_rss_MB'], rates))
+    finally:
+        shutil.rmtree(scratch)
+
+    entry = {'date': datetime.datetime.now().isoformat(timespec='seconds'),
+             'commit': commit(),
+             'host': platform.node(),
+             'threads': os.environ.get('OMP_NUM_THREADS'),
+             'scale': args.scale,
+             'repeat': args.repeat,
+             'tests': results}
+
+    history = []
+    if os.path.exists(args.history):
+        with open(args.history) as f:
+            history = json.load(f)
+    history.append(entry)
+    with open(args.history, 'w') as f:
+        json.dump(history, f, indent=2)
+
+    if args.save_baseline:
+        with open(args.baseline, 'w') as f:
+            json.dump(entry, f, indent=2)
+        print('Baseline stored in {}.'.format(args.baseline))
+        return 0
+
+    if not os.path.exists(args.baseline):
+        print('No baseline in {}. Store one with --save-baseline.'.format(args.baseline))
+        return 0
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    if baseline.get('scale') != args.scale:
+        print('WARNING: the baseline was run with --scale {}.'.format(baseline.get('scale')))
+
+    regressions = compare(results, baseline, args.threshold)
+    for test, quantity, before, now in regressions:
+        print('REGRESSION test_{}: {} {:.3g} -> {:.3g} ({:+.1f}%)'.format(
+            test, quantity, before, now, 100 * (now - before) / before))
+    if not regressions:
+        print('No regressions beyond {:.0f}% against {}.'.format(100 * args.threshold, args.baseline))
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -11,6 +11,7 @@
 #include <complex>
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <omp.h>
 
 #include "H5Cpp.h"
@@ -170,6 +171,17 @@ bool conductivity_dc<T, DIM>::fetch_parameters(){
   get_hdf5(&direction, &file, (char*)(dirName+"Direction").c_str());
   std::string dirString = num2str2(direction);
 
+  // KITEx may have calculated several directions. The shell input chooses which one to use
+  if(variables.CondDC_Direction != ""){
+    dirString = variables.CondDC_Direction;
+    const std::string avail[] = {"xx", "yy", "zz", "xy", "xz", "yx", "yz", "zx", "zy"};
+    direction = std::find(avail, avail + 9, dirString) - avail;
+    if(direction > 8){
+      std::cout << "Conductivity DC: invalid direction " << dirString << ". Exiting.\n";
+      exit(1);
+    }
+  }
+
   // Fetch the number of Chebyshev Moments
 	get_hdf5(&MaxMoments, &file, (char*)(dirName+"NumMoments").c_str());	
 
@@ -90,6 +90,7 @@ void dos<T, DIM>::set_default_parameters(){
 
     filename  = "dos.dat";      // Filename to save final result
     default_filename = true;
+    pdos_filename = "pdos.dat"; // Filename of the DOS projected on each orbital
   
     Emax = 0.99;
     Emin = -0.99;
@@ -185,6 +186,22 @@ bool dos<T, DIM>::fetch_parameters(){
 
     result = true;
   } catch(H5::Exception& e) {debug_message("DOS: There is no MU matrix.\n");}
+
+    // The moments split by orbital, if KITEx was asked for the projected DOS
+    pdos = false;
+    MatrixName = dirName + "MUOrbitals";
+    try{
+		int orbitals = systemInfo->num_orbitals;
+		if(complex){
+			MUOrbitals = Eigen::Array<std::complex<T>,-1,-1>::Zero(orbitals, MaxMoments);
+			get_hdf5(MUOrbitals.data(), &file, (char*)MatrixName.c_str());
+		} else {
+			Eigen::Array<T,-1,-1> MUReal = Eigen::Array<T,-1,-1>::Zero(orbitals, MaxMoments);
+			get_hdf5(MUReal.data(), &file, (char*)MatrixName.c_str());
+			MUOrbitals = MUReal.template cast<std::complex<T>>();
+		}
+		pdos = true;
+    } catch(H5::Exception& e) {debug_message("DOS: There is no MUOrbitals matrix.\n");}
 	
 
   NumMoments = MaxMoments;
@@ -210,6 +227,9 @@ void dos<U, DIM>::printDOS(){
         "   Filename: "             << filename         << ((default_filename)?         " (default)":"") << "\n"
         "   Number of moments: "    << NumMoments       << ((default_NumMoments)?       " (default)":"") << "\n"
         "   Kernel: "               << kernel           << ((default_kernel)?           " (default)":"") << "\n";
+    if(pdos){
+        std::cout << "   Projected DOS: "        << pdos_filename    << "\n";
+    }
     if(kernel == "green"){
         std::cout << "   Kernel parameter: "     << kernel_parameter*scale << ((default_kernel_parameter)? " (default)":"") << "\n";
     }
@@ -223,8 +243,15 @@ void dos<U, DIM>::calculate(){
 
 
   // First perform the part of the product that only depends on the
-  // chebyshev polynomial of the first kind
-  GammaE = Eigen::Array<std::complex<U>, -1, -1>::Zero(NEnergies, 1);
+  // chebyshev polynomial of the first kind. The kernels are applied to every
+  // row of moments: the total DOS and, with the projected DOS, each orbital
+  Eigen::Array<std::complex<U>, -1, -1> moments = MU;
+  if(pdos){
+    moments.resize(1 + MUOrbitals.rows(), MU.cols());
+    moments << MU, MUOrbitals;
+  }
+  Eigen::Array<std::complex<U>, -1, -1> expanded;
+  expanded = Eigen::Array<std::complex<U>, -1, -1>::Zero(NEnergies, moments.rows());
 
   U scale = systemInfo->energy_scale;
   U mult = 1.0/scale;
@@ -237,7 +264,7 @@ void dos<U, DIM>::calculate(){
     for(int i = 0; i < NEnergies; i++){
       for(int m = 0; m < NumMoments; m++){
         factor = 1.0/(1.0 + U(m==0));
-        GammaE(i) += MU(m)*delta(m,energies(i))*kernel_jackson<U>(m, NumMoments)*factor*mult;
+        expanded.row(i) += moments.col(m).transpose()*delta(m,energies(i))*kernel_jackson<U>(m, NumMoments)*factor*mult;
       }
     }
   }
@@ -248,13 +275,15 @@ void dos<U, DIM>::calculate(){
       c_energy = std::complex<U>(energies(i), kernel_parameter);
       for(int m = 0; m < NumMoments; m++){
         factor = 1.0/(1.0 + U(m==0))/M_PI;
-        GammaE(i) += -MU(m)*factor*mult*green<std::complex<U>>(m, 1, c_energy).imag();
+        expanded.row(i) += -moments.col(m).transpose()*factor*mult*green<std::complex<U>>(m, 1, c_energy).imag();
       }
     }
   }
 
 
 
+  GammaE = expanded.col(0);
+
   // Save the density of states to a file and find its maximum value
   std::ofstream myfile;
   myfile.open(filename);
@@ -263,6 +292,18 @@ void dos<U, DIM>::calculate(){
   }
 
   myfile.close();
+
+  // One column for each orbital
+  if(pdos){
+    myfile.open(pdos_filename);
+    for(int i=0; i < NEnergies; i++){
+      myfile  << energies(i)*scale + shift;
+      for(int o = 1; o < expanded.cols(); o++)
+        myfile << " " << expanded(i, o).real();
+      myfile << "\n";
+    }
+    myfile.close();
+  }
   dos_finished = true;
   
   
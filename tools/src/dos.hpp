@@ -39,6 +39,9 @@ class dos{
 
 
         Eigen::Array<std::complex<T>, -1, -1> MU;   // Objects required to successfully calculate the conductivity
+        Eigen::Array<std::complex<T>, -1, -1> MUOrbitals;   // moments split by orbital, one row each
+        bool pdos;                                          // were the moments split by orbital?
+        std::string pdos_filename;
 
         Eigen::Array<std::complex<T>, -1, -1> GammaE;
         bool dos_finished;
@@ -32,6 +32,7 @@ void shell_input::printDC(){
     if(CondDC_FermiMax != -8888)    std::cout << "    maximum Fermi energy: "       << CondDC_FermiMax << "\n";
     if(CondDC_NumFermi != -1)       std::cout << "    number of Fermi energies: "   << CondDC_NumFermi << "\n";
     if(CondDC_Name != "")           std::cout << "    name of the output file: "    << CondDC_Name << "\n";
+    if(CondDC_Direction != "")      std::cout << "    direction: "                  << CondDC_Direction << "\n";
     if(CondDC_Exclusive == true)    std::cout << "    Exclusive.\n";
     std::cout << "\n";
 } 
@@ -138,6 +139,7 @@ void shell_input::printHelp(){
     std::cout << "           -I              If 0, uses the DoS to estimate integration range\n";
     std::cout << "           -F min max num  Fermi energies. min and max may be ommited.\n";
     std::cout << "           -N              Name of the output file\n";
+    std::cout << "           -D              Direction to post-process, when KITEx calculated several (xx, xy, ...)\n";
     std::cout << "           -M              Number of Chebyshev moments to use in the calculation\n";
     std::cout << "           -t              Number of threads\n";
     std::cout << "           -X              Exclusive. Only calculate this quantity\n\n";
@@ -292,6 +294,7 @@ void shell_input::parse_CondDC(int argc, char *argv[]){
     CondDC_Scat = -8888;
     CondDC_deltaScat = -8888;
     CondDC_Name = "";
+    CondDC_Direction = "";
     CondDC_Exclusive = false;
     CondDC_nthreads = -1;
     // Process CondDC
@@ -318,6 +321,8 @@ void shell_input::parse_CondDC(int argc, char *argv[]){
                 CondDC_nthreads = atoi(n1.c_str());
             if(name == "-N")
                 CondDC_Name = n1;
+            if(name == "-D")
+                CondDC_Direction = n1;
             if(name == "-X" or n1 == "-X")
                 CondDC_Exclusive = true;
             if(name == "-F"){
@@ -326,7 +331,7 @@ void shell_input::parse_CondDC(int argc, char *argv[]){
                     continue;
                 } else {
                     std::string n2 = argv[k + pos + 2];
-                    if(n2 == "-T" or n2 == "-E" or n2 == "-F" or n2 == "-S" or n2 == "-N" or n2 == "-X"){
+                    if(n2 == "-T" or n2 == "-E" or n2 == "-F" or n2 == "-S" or n2 == "-N" or n2 == "-D" or n2 == "-X"){
                         CondDC_NumFermi = atoi(n1.c_str());
                     } else {
                         std::string n3 = argv[k + pos + 3];
@@ -21,6 +21,7 @@ class shell_input{
         double CondDC_FermiMax; 
         int CondDC_NumFermi; 
         std::string CondDC_Name;
+        std::string CondDC_Direction;
         bool CondDC_Exclusive;
         bool CondDC_is_required;
 